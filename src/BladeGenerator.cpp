@@ -0,0 +1,302 @@
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include "BladeGenerator.h"
+#include "BufferUtils.h"
+#include "ShaderModule.h"
+
+namespace {
+    // Values baked into generate.comp through specialization constants
+    struct GeneratorConstants {
+        uint32_t bladesPerTile = BLADES_PER_TILE;
+        uint32_t tileGridDim = TILE_GRID_DIM;
+        uint32_t placementSetCount = PLACEMENT_SET_COUNT;
+        VkBool32 mortonOrder = ENABLE_BLADE_MORTON_ORDER;
+    };
+
+    static_assert((BLADES_PER_TILE & (BLADES_PER_TILE - 1)) == 0, "generate.comp reduces tile bounds over a power-of-two workgroup");
+    static_assert(BLADES_PER_TILE <= 4096, "generate.comp packs the invocation into the low 12 bits of its sort keys");
+}
+
+BladeGenerator::BladeGenerator(Device* device, Blades* pool, const Terrain* terrain, uint32_t maxRequests)
+    : device(device), pool(pool), maxRequests(maxRequests) {
+    vk::DeviceSize requestsSize = maxRequests * sizeof(BladePatchRequest);
+    BufferUtils::CreateBuffer(device, requestsSize, vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, requestsBuffer, requestsBufferMemory);
+    mappedRequests = static_cast<BladePatchRequest*>(device->GetLogicalDevice().mapMemory(requestsBufferMemory, 0, requestsSize));
+
+    vk::DeviceSize regionsSize = BLADE_REGION_COUNT * sizeof(BladeRegion);
+    BufferUtils::CreateBuffer(device, regionsSize, vk::BufferUsageFlagBits::eUniformBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, regionsBuffer, regionsBufferMemory);
+    mappedRegions = static_cast<BladeRegion*>(device->GetLogicalDevice().mapMemory(regionsBufferMemory, 0, regionsSize));
+
+    // Meadows keep the ranges of Blades.h, hilltops are wind-swept and short, hollows grow tall and soft
+    BladeRegion meadow = { { MIN_HEIGHT, MAX_HEIGHT }, { MIN_WIDTH, MAX_WIDTH }, { MIN_BEND, MAX_BEND }, glm::vec2(0.0f) };
+    for (uint32_t i = 0; i < BLADE_REGION_COUNT; i++) {
+        mappedRegions[i] = meadow;
+    }
+    mappedRegions[TERRAIN_REGION_HILLTOP] = { { 0.6f, 1.2f }, { 0.06f, 0.1f }, { 12.0f, 18.0f }, glm::vec2(0.0f) };
+    mappedRegions[TERRAIN_REGION_HOLLOW] = { { 2.0f, 3.2f }, { 0.09f, 0.14f }, { 5.0f, 10.0f }, glm::vec2(0.0f) };
+
+    // Small and never changes, so it stays in host-visible memory rather than needing a transfer
+    const std::vector<glm::vec2>& placementSets = Blades::GetPlacementSets();
+    vk::DeviceSize placementSize = placementSets.size() * sizeof(glm::vec2);
+    BufferUtils::CreateBuffer(device, placementSize, vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, placementBuffer, placementBufferMemory);
+    void* placementData = device->GetLogicalDevice().mapMemory(placementBufferMemory, 0, placementSize);
+    memcpy(placementData, placementSets.data(), static_cast<size_t>(placementSize));
+    device->GetLogicalDevice().unmapMemory(placementBufferMemory);
+
+    CreateDescriptorSet(terrain);
+    CreatePipeline();
+
+    if (ENABLE_SHADER_HOT_RELOAD) {
+        shaderWatcher = new ShaderWatcher(std::chrono::milliseconds(500));
+        shaderWatcher->Watch({ "shaders/generate.comp.spv" }, [this]() {
+            try {
+                vk::Pipeline rebuilt = BuildPipeline();
+                std::lock_guard<std::mutex> lock(reloadMutex);
+                if (reloadedPipeline) {
+                    device->GetLogicalDevice().destroyPipeline(reloadedPipeline);
+                }
+                reloadedPipeline = rebuilt;
+            }
+            catch (std::exception& err) {
+                fprintf(stderr, "Shader reload failed: %s\n", err.what());
+            }
+        });
+        shaderWatcher->Start();
+    }
+}
+
+void BladeGenerator::CreateDescriptorSet(const Terrain* terrain) {
+    vk::Device logicalDevice = device->GetLogicalDevice();
+
+    // Blades, tiles and requests, the height and normal map the blades are rooted on, the grass map, the region ranges,
+    // the placement sets and the blade states
+    constexpr std::array<vk::DescriptorType, 8> bindingTypes = {
+        vk::DescriptorType::eStorageBuffer, vk::DescriptorType::eStorageBuffer, vk::DescriptorType::eStorageBuffer,
+        vk::DescriptorType::eCombinedImageSampler, vk::DescriptorType::eCombinedImageSampler,
+        vk::DescriptorType::eUniformBuffer, vk::DescriptorType::eStorageBuffer, vk::DescriptorType::eStorageBuffer
+    };
+
+    std::array<vk::DescriptorSetLayoutBinding, bindingTypes.size()> bindings;
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].setBinding(i);
+        bindings[i].setDescriptorType(bindingTypes[i]);
+        bindings[i].setDescriptorCount(1);
+        bindings[i].setStageFlags(vk::ShaderStageFlags(vk::ShaderStageFlagBits::eCompute));
+        bindings[i].setPImmutableSamplers(nullptr);
+    }
+
+    vk::DescriptorSetLayoutCreateInfo layoutInfo;
+    layoutInfo.setBindingCount(static_cast<uint32_t>(bindings.size()));
+    layoutInfo.setPBindings(bindings.data());
+
+    try {
+        descriptorSetLayout = logicalDevice.createDescriptorSetLayout(layoutInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create blade generator descriptor set layout");
+    }
+
+    std::vector<vk::DescriptorPoolSize> poolSizes = {
+        { vk::DescriptorType::eStorageBuffer, 5 },
+        { vk::DescriptorType::eCombinedImageSampler, 2 },
+        { vk::DescriptorType::eUniformBuffer, 1 }
+    };
+
+    vk::DescriptorPoolCreateInfo poolInfo;
+    poolInfo.setPoolSizeCount(static_cast<uint32_t>(poolSizes.size()));
+    poolInfo.setPPoolSizes(poolSizes.data());
+    poolInfo.setMaxSets(1);
+
+    try {
+        descriptorPool = logicalDevice.createDescriptorPool(poolInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create blade generator descriptor pool");
+    }
+
+    vk::DescriptorSetAllocateInfo allocInfo;
+    allocInfo.setDescriptorPool(descriptorPool);
+    allocInfo.setDescriptorSetCount(1);
+    allocInfo.setPSetLayouts(&descriptorSetLayout);
+
+    try {
+        logicalDevice.allocateDescriptorSets(&allocInfo, &descriptorSet);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to allocate blade generator descriptor set");
+    }
+
+    // Indexed by binding, each binding uses the one matching its type
+    std::array<vk::DescriptorBufferInfo, bindingTypes.size()> bufferInfos;
+    bufferInfos[0] = vk::DescriptorBufferInfo(pool->GetBladesBuffer(), 0, pool->GetBladeCount() * sizeof(Blade));
+    bufferInfos[1] = vk::DescriptorBufferInfo(pool->GetTilesBuffer(), 0, pool->GetTileCount() * sizeof(BladeTile));
+    bufferInfos[2] = vk::DescriptorBufferInfo(requestsBuffer, 0, maxRequests * sizeof(BladePatchRequest));
+    bufferInfos[5] = vk::DescriptorBufferInfo(regionsBuffer, 0, BLADE_REGION_COUNT * sizeof(BladeRegion));
+    bufferInfos[6] = vk::DescriptorBufferInfo(placementBuffer, 0, PLACEMENT_SET_COUNT * BLADES_PER_TILE * sizeof(glm::vec2));
+    bufferInfos[7] = vk::DescriptorBufferInfo(pool->GetBladeStatesBuffer(), 0, pool->GetBladeCount() * sizeof(BladeState));
+
+    std::array<vk::DescriptorImageInfo, bindingTypes.size()> imageInfos;
+    imageInfos[3] = vk::DescriptorImageInfo(terrain->GetMapSampler(), terrain->GetMapView(), vk::ImageLayout::eShaderReadOnlyOptimal);
+    imageInfos[4] = vk::DescriptorImageInfo(terrain->GetMapSampler(), terrain->GetGrassMapView(), vk::ImageLayout::eShaderReadOnlyOptimal);
+
+    std::array<vk::WriteDescriptorSet, bindingTypes.size()> descriptorWrites;
+    for (uint32_t i = 0; i < descriptorWrites.size(); i++) {
+        descriptorWrites[i].setDstSet(descriptorSet);
+        descriptorWrites[i].setDstBinding(i);
+        descriptorWrites[i].setDstArrayElement(0);
+        descriptorWrites[i].setDescriptorType(bindingTypes[i]);
+        descriptorWrites[i].setDescriptorCount(1);
+        if (bindingTypes[i] == vk::DescriptorType::eCombinedImageSampler) {
+            descriptorWrites[i].setPImageInfo(&imageInfos[i]);
+        }
+        else {
+            descriptorWrites[i].setPBufferInfo(&bufferInfos[i]);
+        }
+    }
+
+    logicalDevice.updateDescriptorSets(static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+void BladeGenerator::CreatePipeline() {
+    vk::Device logicalDevice = device->GetLogicalDevice();
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+    pipelineLayoutInfo.setSetLayoutCount(1);
+    pipelineLayoutInfo.setPSetLayouts(&descriptorSetLayout);
+    pipelineLayoutInfo.setPushConstantRangeCount(0);
+    pipelineLayoutInfo.setPushConstantRanges(0);
+
+    try {
+        pipelineLayout = logicalDevice.createPipelineLayout(pipelineLayoutInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create blade generator pipeline layout");
+    }
+
+    pipeline = BuildPipeline();
+}
+
+vk::Pipeline BladeGenerator::BuildPipeline() {
+    vk::Device logicalDevice = device->GetLogicalDevice();
+
+    vk::ShaderModule shaderModule = ShaderModule::Create("shaders/generate.comp.spv", logicalDevice);
+
+    GeneratorConstants constants;
+    std::array<vk::SpecializationMapEntry, 4> specializationEntries = {
+        vk::SpecializationMapEntry(0, offsetof(GeneratorConstants, bladesPerTile), sizeof(uint32_t)),
+        vk::SpecializationMapEntry(1, offsetof(GeneratorConstants, tileGridDim), sizeof(uint32_t)),
+        vk::SpecializationMapEntry(2, offsetof(GeneratorConstants, placementSetCount), sizeof(uint32_t)),
+        vk::SpecializationMapEntry(3, offsetof(GeneratorConstants, mortonOrder), sizeof(VkBool32)),
+    };
+
+    vk::SpecializationInfo specializationInfo;
+    specializationInfo.setMapEntryCount(static_cast<uint32_t>(specializationEntries.size()));
+    specializationInfo.setPMapEntries(specializationEntries.data());
+    specializationInfo.setDataSize(sizeof(GeneratorConstants));
+    specializationInfo.setPData(&constants);
+
+    vk::PipelineShaderStageCreateInfo shaderStageInfo;
+    shaderStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+    shaderStageInfo.setModule(shaderModule);
+    shaderStageInfo.setPName("main");
+    shaderStageInfo.setPSpecializationInfo(&specializationInfo);
+
+    vk::ComputePipelineCreateInfo pipelineInfo;
+    pipelineInfo.setStage(shaderStageInfo);
+    pipelineInfo.setLayout(pipelineLayout);
+    pipelineInfo.setBasePipelineHandle(nullptr);
+    pipelineInfo.setBasePipelineIndex(-1);
+
+    vk::Pipeline pipeline;
+    try {
+        pipeline = (vk::Pipeline)logicalDevice.createComputePipeline(nullptr, pipelineInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create blade generator pipeline");
+    }
+
+    logicalDevice.destroyShaderModule(shaderModule);
+
+    return pipeline;
+}
+
+void BladeGenerator::Generate(uint32_t patch, glm::vec2 center, float size, uint32_t seed) {
+    if (requestCount == maxRequests) {
+        throw std::runtime_error("Too many blade patch requests queued");
+    }
+    mappedRequests[requestCount++] = { center, size, seed, patch, 0 };
+}
+
+void BladeGenerator::Clear(uint32_t patch) {
+    if (requestCount == maxRequests) {
+        throw std::runtime_error("Too many blade patch requests queued");
+    }
+    mappedRequests[requestCount++] = { glm::vec2(0.0f), 0.0f, 0, patch, 1 };
+}
+
+void BladeGenerator::SetRegion(uint32_t region, const BladeRegion& ranges) {
+    if (region >= BLADE_REGION_COUNT) {
+        throw std::runtime_error("Blade region out of range");
+    }
+    mappedRegions[region] = ranges;
+}
+
+bool BladeGenerator::Record(vk::CommandBuffer commandBuffer) {
+    if (requestCount == 0) {
+        return false;
+    }
+
+    // The previous batch has completed, so nothing uses the old pipeline anymore
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        if (reloadedPipeline) {
+            device->GetLogicalDevice().destroyPipeline(pipeline);
+            pipeline = reloadedPipeline;
+            reloadedPipeline = nullptr;
+        }
+    }
+
+    // Frames submitted earlier may still simulate and cull the patches being replaced
+    vk::MemoryBarrier readBarrier;
+    readBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    readBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderWrite);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(0), 1, &readBarrier, 0, nullptr, 0, nullptr);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    commandBuffer.dispatch(NUM_TILES, requestCount, 1);
+
+    // The frames submitted after this on the same queue read the new blades and tiles
+    vk::MemoryBarrier writeBarrier;
+    writeBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+    writeBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(0), 1, &writeBarrier, 0, nullptr, 0, nullptr);
+
+    requestCount = 0;
+    return true;
+}
+
+BladeGenerator::~BladeGenerator() {
+    // Stops the watcher thread before the pipelines it builds go away
+    delete shaderWatcher;
+
+    vk::Device logicalDevice = device->GetLogicalDevice();
+    if (reloadedPipeline) {
+        logicalDevice.destroyPipeline(reloadedPipeline);
+    }
+    logicalDevice.destroyPipeline(pipeline);
+    logicalDevice.destroyPipelineLayout(pipelineLayout);
+    logicalDevice.destroyDescriptorPool(descriptorPool);
+    logicalDevice.destroyDescriptorSetLayout(descriptorSetLayout);
+    logicalDevice.destroyBuffer(placementBuffer);
+    logicalDevice.freeMemory(placementBufferMemory);
+    logicalDevice.unmapMemory(regionsBufferMemory);
+    logicalDevice.destroyBuffer(regionsBuffer);
+    logicalDevice.freeMemory(regionsBufferMemory);
+    logicalDevice.unmapMemory(requestsBufferMemory);
+    logicalDevice.destroyBuffer(requestsBuffer);
+    logicalDevice.freeMemory(requestsBufferMemory);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <mutex>
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+#include "Device.h"
+#include "Blades.h"
+#include "Terrain.h"
+#include "ShaderWatcher.h"
+
+// A patch for shaders/generate.comp to fill or clear, matching PatchRequest there
+struct BladePatchRequest {
+    glm::vec2 center;
+    float size;
+    uint32_t seed;
+    uint32_t patch;
+    uint32_t empty;
+};
+
+// Blade ranges for one region of the terrain's grass map, matching Region in generate.comp (std140)
+struct BladeRegion {
+    glm::vec2 height;     // min, max
+    glm::vec2 width;
+    glm::vec2 stiffness;
+    glm::vec2 padding;
+};
+
+constexpr static uint32_t BLADE_REGION_COUNT = 4;
+
+// Fills patches of a Blades pool on the GPU from a center, a size and a seed, rooted on the terrain.
+// Roots come from the blue noise placement sets of Blades and are thinned out by the density in the terrain's grass map.
+// Blades take their ranges from the map's region under them.
+// Each tile keeps only the blades that survived, packed at its start, so bare ground is neither simulated nor drawn.
+// Queued requests are recorded as one dispatch with a workgroup per tile, so regenerating patches at runtime
+// costs the CPU a few bytes each and the blades never leave device memory.
+class BladeGenerator {
+public:
+    BladeGenerator() = delete;
+    // Up to maxRequests patches can be queued between two calls to Record
+    BladeGenerator(Device* device, Blades* pool, const Terrain* terrain, uint32_t maxRequests);
+    ~BladeGenerator();
+
+    // Queues the size x size field around center for the given patch. The same seed always grows the same field.
+    void Generate(uint32_t patch, glm::vec2 center, float size, uint32_t seed);
+    // Queues the patch to be emptied, so none of its blades are simulated or drawn
+    void Clear(uint32_t patch);
+
+    // Changes the blade ranges of a region for the patches recorded from then on. Like the requests, the ranges are
+    // host-visible: don't change them while recorded commands are in flight.
+    void SetRegion(uint32_t region, const BladeRegion& ranges);
+
+    // Records the queued requests into a compute command buffer and empties the queue. Returns false when nothing
+    // was queued. The request buffer is host-visible: don't queue more until the recorded commands have completed.
+    bool Record(vk::CommandBuffer commandBuffer);
+
+private:
+    void CreateDescriptorSet(const Terrain* terrain);
+    void CreatePipeline();
+    vk::Pipeline BuildPipeline();
+
+    Device* device;
+    Blades* pool;
+    uint32_t maxRequests;
+    uint32_t requestCount = 0;
+
+    vk::Buffer requestsBuffer;
+    vk::DeviceMemory requestsBufferMemory;
+    BladePatchRequest* mappedRequests;
+
+    vk::Buffer regionsBuffer;
+    vk::DeviceMemory regionsBufferMemory;
+    BladeRegion* mappedRegions;
+
+    // Blades::GetPlacementSets, written once
+    vk::Buffer placementBuffer;
+    vk::DeviceMemory placementBufferMemory;
+
+    vk::DescriptorSetLayout descriptorSetLayout;
+    vk::DescriptorPool descriptorPool;
+    vk::DescriptorSet descriptorSet;
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline pipeline;
+
+    // Rebuilt on the watcher thread when generate.comp.spv changes, swapped in by the next Record
+    ShaderWatcher* shaderWatcher = nullptr;
+    std::mutex reloadMutex;
+    vk::Pipeline reloadedPipeline;
+};
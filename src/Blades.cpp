@@ -1,60 +1,217 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
 #include <vector>
+#include <glm/gtc/packing.hpp>
 #include "Blades.h"
+#include "BlueNoise.h"
 #include "BufferUtils.h"
+#include "Terrain.h"
 
-float generateRandomFloat() {
-    return rand() / (float)RAND_MAX;
+namespace {
+    // Folds a unit vector onto the unit square, matching octEncode in shaders/blade.glsl
+    glm::vec2 octEncode(glm::vec3 n) {
+        n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        glm::vec2 e(n.x, n.z);
+        if (n.y < 0.0f) {
+            e = (1.0f - glm::abs(glm::vec2(e.y, e.x))) * glm::vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        return e;
+    }
+}
+
+Blade Blade::Pack(glm::vec3 root, glm::vec3 up, float direction, float height, float width, float stiffness) {
+    Blade blade;
+    blade.v0 = root;
+    blade.up = glm::packSnorm2x16(octEncode(up));
+    blade.attributes = glm::uvec2(glm::packHalf2x16(glm::vec2(direction, width)), glm::packHalf2x16(glm::vec2(stiffness, height)));
+    return blade;
+}
+
+BladeState BladeState::Pack(glm::vec3 guide) {
+    BladeState state;
+    state.v2 = glm::uvec2(glm::packHalf2x16(glm::vec2(guide.x, guide.y)), glm::packHalf2x16(glm::vec2(guide.z, -1.0f)));
+    // An upright blade bends at its tip
+    state.bend = glm::length(guide);
+    state.padding = 0;
+    return state;
 }
 
-Blades::Blades(Device* device, vk::CommandPool commandPool, float planeDim) 
-    : Model(device, commandPool, {}, {}) 
+Blades::Blades(Device* device, vk::CommandPool commandPool, float planeDim, const Terrain* terrain) 
+    : Model(device, commandPool, {}, {}),
+      patchCount(1)
 {
-    std::vector<Blade> blades;
-    blades.reserve(NUM_BLADES);
+    std::vector<Blade> blades(NUM_BLADES);
+    std::vector<BladeState> states(NUM_BLADES);
+    std::vector<BladeTile> tiles(NUM_TILES);
+    Generate(planeDim, glm::vec2(0.0f), 0, terrain, blades.data(), states.data(), tiles.data());
+
+    CreateBuffers(commandPool, blades.data(), states.data(), tiles.data());
+}
+
+Blades::Blades(Device* device, vk::CommandPool commandPool, uint32_t patchCount)
+    : Model(device, commandPool, {}, {}),
+      patchCount(patchCount)
+{
+    std::vector<BladeTile> tiles(patchCount * NUM_TILES, BladeTile());
+    CreateBuffers(commandPool, nullptr, nullptr, tiles.data());
+}
 
-    for (int i = 0; i < NUM_BLADES; i++) {
-        Blade currentBlade = Blade();
+void Blades::Generate(float planeDim, glm::vec2 center, uint32_t seed, const Terrain* terrain, Blade* blades, BladeState* states, BladeTile* tiles) {
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    auto generateRandomFloat = [&]() { return distribution(engine); };
 
-        glm::vec3 bladeUp(0.0f, 1.0f, 0.0f);
+    const std::vector<glm::vec2>& placementSets = GetPlacementSets();
+    float cellSize = planeDim / TILE_GRID_DIM;
+
+    // The tile's blades keyed by their position in it, to be written out in Z-order
+    struct KeyedBlade {
+        uint32_t key;
+        Blade blade;
+        BladeState state;
+    };
+    std::vector<KeyedBlade> tileBlades(BLADES_PER_TILE);
+
+    for (uint32_t i = 0; i < NUM_TILES; i++) {
+        BladeTile& tile = tiles[i];
+        tile = BladeTile();
+        tile.firstBlade = i * BLADES_PER_TILE;
+        tile.bladeCount = BLADES_PER_TILE;
+        tile.boundsMin = glm::vec4(std::numeric_limits<float>::max());
+        tile.boundsMax = glm::vec4(-std::numeric_limits<float>::max());
+
+        // One of the sets in one of its 8 mirrorings and transpositions, all of which still tile seamlessly
+        uint32_t variant = static_cast<uint32_t>(generateRandomFloat() * PLACEMENT_SET_COUNT * 8) % (PLACEMENT_SET_COUNT * 8);
+        const glm::vec2* points = &placementSets[(variant / 8) * BLADES_PER_TILE];
+        glm::vec2 cellCorner = center - 0.5f * planeDim + glm::vec2(GetTileCell(i)) * cellSize;
+
+        for (uint32_t j = 0; j < BLADES_PER_TILE; j++) {
+            // Generate positions and direction (v0)
+            glm::vec2 point = points[j];
+            if (variant & 1) point.x = 1.0f - point.x;
+            if (variant & 2) point.y = 1.0f - point.y;
+            if (variant & 4) point = glm::vec2(point.y, point.x);
+            float x = cellCorner.x + point.x * cellSize;
+            float z = cellCorner.y + point.y * cellSize;
+            float y = terrain ? terrain->GetHeight(glm::vec2(x, z)) : 0.0f;
+            glm::vec3 bladeUp = terrain ? terrain->GetNormal(glm::vec2(x, z)) : glm::vec3(0.0f, 1.0f, 0.0f);
+            float direction = generateRandomFloat() * 2.f * 3.14159265f;
+            glm::vec3 bladePosition(x, y, z);
+
+            // Height, width and stiffness coefficient; the blade starts out upright
+            float height = MIN_HEIGHT + (generateRandomFloat() * (MAX_HEIGHT - MIN_HEIGHT));
+            float width = MIN_WIDTH + (generateRandomFloat() * (MAX_WIDTH - MIN_WIDTH));
+            float stiffness = MIN_BEND + (generateRandomFloat() * (MAX_BEND - MIN_BEND));
+            Blade currentBlade = Blade::Pack(bladePosition, bladeUp, direction, height, width, stiffness);
+            BladeState currentState = BladeState::Pack(bladeUp * height);
+
+            // 10 bits per axis is finer than blades are apart
+            glm::uvec2 quantized = glm::min(glm::uvec2(point * 1024.0f), glm::uvec2(1023));
+            tileBlades[j] = { ENABLE_BLADE_MORTON_ORDER ? MortonCode(quantized.x, quantized.y) : j, currentBlade, currentState };
+
+            // A blade can bend up to its height in any direction around its root, but never below the ground it stands on.
+            // On a slope that ground drops away by up to the slope times the reach.
+            float reach = height + width;
+            float drop = reach * glm::length(glm::vec2(bladeUp.x, bladeUp.z)) / bladeUp.y;
+            tile.boundsMin = glm::min(tile.boundsMin, glm::vec4(bladePosition - glm::vec3(reach, drop, reach), 0.0f));
+            tile.boundsMax = glm::max(tile.boundsMax, glm::vec4(bladePosition + glm::vec3(reach, 0.0f, reach) + bladeUp * height, 0.0f));
+        }
+
+        std::sort(tileBlades.begin(), tileBlades.end(), [](const KeyedBlade& a, const KeyedBlade& b) { return a.key < b.key; });
+        for (uint32_t j = 0; j < BLADES_PER_TILE; j++) {
+            blades[tile.firstBlade + j] = tileBlades[j].blade;
+            states[tile.firstBlade + j] = tileBlades[j].state;
+        }
+    }
+}
 
-        // Generate positions and direction (v0)
-        float x = (generateRandomFloat() - 0.5f) * planeDim;
-        float y = 0.0f;
-        float z = (generateRandomFloat() - 0.5f) * planeDim;
-        float direction = generateRandomFloat() * 2.f * 3.14159265f;
-        glm::vec3 bladePosition(x, y, z);
-        currentBlade.v0 = glm::vec4(bladePosition, direction);
+const std::vector<glm::vec2>& Blades::GetPlacementSets() {
+    static const std::vector<glm::vec2> placementSets = BlueNoise::GenerateTileSets(BLADES_PER_TILE, PLACEMENT_SET_COUNT, 0);
+    return placementSets;
+}
 
-        // Bezier point and height (v1)
-        float height = MIN_HEIGHT + (generateRandomFloat() * (MAX_HEIGHT - MIN_HEIGHT));
-        currentBlade.v1 = glm::vec4(bladePosition + bladeUp * height, height);
+void Blades::CreateBuffers(vk::CommandPool commandPool, Blade* blades, BladeState* states, BladeTile* tiles) {
+    BladeDispatchIndirect indirectDispatch;
+    indirectDispatch.x = 0;
+    indirectDispatch.y = 1;
+    indirectDispatch.z = 1;
 
-        // Physical model guide and width (v2)
-        float width = MIN_WIDTH + (generateRandomFloat() * (MAX_WIDTH - MIN_WIDTH));
-        currentBlade.v2 = glm::vec4(bladePosition + bladeUp * height, width);
+    // The culling pass fills in the instance counts, and the first instance of far bins
+    std::array<BladeDrawIndirect, BLADE_DRAW_COUNT> indirectDraws;
+    for (uint32_t draw = 0; draw < BLADE_DRAW_COUNT; draw++) {
+        indirectDraws[draw].vertexCount = BLADE_LOD_VERTEX_COUNTS[draw / BLADE_DEPTH_BIN_COUNT];
+        indirectDraws[draw].instanceCount = 0;
+        indirectDraws[draw].firstVertex = 0;
+        indirectDraws[draw].firstInstance = 0;
+    }
 
-        // Up vector and stiffness coefficient (up)
-        float stiffness = MIN_BEND + (generateRandomFloat() * (MAX_BEND - MIN_BEND));
-        currentBlade.up = glm::vec4(bladeUp, stiffness);
+    // Without initial blades they are left to be filled in place later, the tiles always start out valid
+    if (blades) {
+        BufferUtils::CreateBufferFromData(device, commandPool, blades, GetBladeCount() * sizeof(Blade), vk::BufferUsageFlagBits::eStorageBuffer, bladesBuffer, bladesBufferMemory);
+        BufferUtils::CreateBufferFromData(device, commandPool, states, GetBladeCount() * sizeof(BladeState), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc, bladeStatesBuffer, bladeStatesBufferMemory);
+    }
+    else {
+        BufferUtils::CreateBuffer(device, GetBladeCount() * sizeof(Blade), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal, bladesBuffer, bladesBufferMemory);
+        BufferUtils::CreateBuffer(device, GetBladeCount() * sizeof(BladeState), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal, bladeStatesBuffer, bladeStatesBufferMemory);
+    }
+    BufferUtils::CreateBufferFromData(device, commandPool, tiles, GetTileCount() * sizeof(BladeTile), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc, tilesBuffer, tilesBufferMemory);
+    BufferUtils::CreateBuffer(device, BLADE_LOD_COUNT * GetBladeCount() * sizeof(CulledBlade), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, culledBladesBuffer, culledBladesBufferMemory);
+    BufferUtils::CreateBufferFromData(device, commandPool, indirectDraws.data(), BLADE_DRAW_COUNT * sizeof(BladeDrawIndirect), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferSrc, numBladesBuffer, numBladesBufferMemory);
+    BufferUtils::CreateBuffer(device, GetTileCount() * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, visibleTilesBuffer, visibleTilesBufferMemory);
+    BufferUtils::CreateBufferFromData(device, commandPool, &indirectDispatch, sizeof(BladeDispatchIndirect), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, dispatchIndirectBuffer, dispatchIndirectBufferMemory);
+}
 
-        blades.push_back(currentBlade);
+glm::uvec2 Blades::GetTileCell(uint32_t tile) {
+    if (!ENABLE_BLADE_MORTON_ORDER) {
+        return glm::uvec2(tile % TILE_GRID_DIM, tile / TILE_GRID_DIM);
     }
 
-    BladeDrawIndirect indirectDraw;
-    indirectDraw.vertexCount = NUM_BLADES;
-    indirectDraw.instanceCount = 1;
-    indirectDraw.firstVertex = 0;
-    indirectDraw.firstInstance = 0;
+    // Undo the interleaving of MortonCode
+    auto compactBits = [](uint32_t v) {
+        v &= 0x55555555u;
+        v = (v | (v >> 1)) & 0x33333333u;
+        v = (v | (v >> 2)) & 0x0f0f0f0fu;
+        v = (v | (v >> 4)) & 0x00ff00ffu;
+        v = (v | (v >> 8)) & 0x0000ffffu;
+        return v;
+    };
+    return glm::uvec2(compactBits(tile), compactBits(tile >> 1));
+}
+
+uint32_t Blades::MortonCode(uint32_t x, uint32_t z) {
+    auto spreadBits = [](uint32_t v) {
+        v &= 0x0000ffffu;
+        v = (v | (v << 8)) & 0x00ff00ffu;
+        v = (v | (v << 4)) & 0x0f0f0f0fu;
+        v = (v | (v << 2)) & 0x33333333u;
+        v = (v | (v << 1)) & 0x55555555u;
+        return v;
+    };
+    return spreadBits(x) | (spreadBits(z) << 1);
+}
+
+uint32_t Blades::GetPatchCount() const {
+    return patchCount;
+}
+
+uint32_t Blades::GetBladeCount() const {
+    return patchCount * NUM_BLADES;
+}
 
-    BufferUtils::CreateBufferFromData(device, commandPool, blades.data(), NUM_BLADES * sizeof(Blade), vk::BufferUsageFlagBits::eStorageBuffer, bladesBuffer, bladesBufferMemory);
-    BufferUtils::CreateBuffer(device, NUM_BLADES * sizeof(Blade), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eHostVisible, culledBladesBuffer, culledBladesBufferMemory);
-    BufferUtils::CreateBufferFromData(device, commandPool, &indirectDraw, sizeof(BladeDrawIndirect), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, numBladesBuffer, numBladesBufferMemory);
+uint32_t Blades::GetTileCount() const {
+    return patchCount * NUM_TILES;
 }
 
 vk::Buffer Blades::GetBladesBuffer() const {
     return bladesBuffer;
 }
 
+vk::Buffer Blades::GetBladeStatesBuffer() const {
+    return bladeStatesBuffer;
+}
+
 vk::Buffer Blades::GetCulledBladesBuffer() const {
     return culledBladesBuffer;
 }
@@ -63,11 +220,31 @@ vk::Buffer Blades::GetNumBladesBuffer() const {
     return numBladesBuffer;
 }
 
+vk::Buffer Blades::GetTilesBuffer() const {
+    return tilesBuffer;
+}
+
+vk::Buffer Blades::GetVisibleTilesBuffer() const {
+    return visibleTilesBuffer;
+}
+
+vk::Buffer Blades::GetDispatchIndirectBuffer() const {
+    return dispatchIndirectBuffer;
+}
+
 Blades::~Blades() {
     device->GetLogicalDevice().destroyBuffer(bladesBuffer);
     device->GetLogicalDevice().freeMemory(bladesBufferMemory);
+    device->GetLogicalDevice().destroyBuffer(bladeStatesBuffer);
+    device->GetLogicalDevice().freeMemory(bladeStatesBufferMemory);
     device->GetLogicalDevice().destroyBuffer(culledBladesBuffer);
     device->GetLogicalDevice().freeMemory(culledBladesBufferMemory);
     device->GetLogicalDevice().destroyBuffer(numBladesBuffer);
     device->GetLogicalDevice().freeMemory(numBladesBufferMemory);
+    device->GetLogicalDevice().destroyBuffer(tilesBuffer);
+    device->GetLogicalDevice().freeMemory(tilesBufferMemory);
+    device->GetLogicalDevice().destroyBuffer(visibleTilesBuffer);
+    device->GetLogicalDevice().freeMemory(visibleTilesBufferMemory);
+    device->GetLogicalDevice().destroyBuffer(dispatchIndirectBuffer);
+    device->GetLogicalDevice().freeMemory(dispatchIndirectBufferMemory);
 }
@@ -2,8 +2,17 @@
 #include <vulkan/vulkan.hpp>
 #include <glm/glm.hpp>
 #include <array>
+#include <vector>
 #include "Model.h"
 
+class Terrain;
+
+#ifdef BLADE_MORTON_ORDER
+static constexpr bool ENABLE_BLADE_MORTON_ORDER = true;
+#else
+static constexpr bool ENABLE_BLADE_MORTON_ORDER = false;
+#endif
+
 constexpr static unsigned int NUM_BLADES = 1 << 13;
 constexpr static float MIN_HEIGHT = 1.2f;
 constexpr static float MAX_HEIGHT = 2.5f;
@@ -12,22 +21,88 @@ constexpr static float MAX_WIDTH = 0.125f;
 constexpr static float MIN_BEND = 7.0f;
 constexpr static float MAX_BEND = 15.0f;
 
+// The field is split into TILE_GRID_DIM x TILE_GRID_DIM tiles that are culled before individual blades
+constexpr static unsigned int TILE_GRID_DIM = 8;
+constexpr static unsigned int NUM_TILES = TILE_GRID_DIM * TILE_GRID_DIM;
+constexpr static unsigned int BLADES_PER_TILE = NUM_BLADES / NUM_TILES;
+static_assert((TILE_GRID_DIM & (TILE_GRID_DIM - 1)) == 0, "Tiles are numbered along a Z-order curve over a power-of-two grid");
+
+// With ENABLE_BLADE_MORTON_ORDER, tiles are numbered along a Z-order curve over the patch and the blades of a tile are
+// sorted along one over the tile, so blades next to each other in memory are next to each other on the ground.
+// Otherwise tiles go row by row and blades keep the order of their placement set.
+
+// Blades are placed in each tile from one of PLACEMENT_SET_COUNT precomputed blue noise sets, mirrored or transposed
+// at random, so they cover the ground evenly instead of clumping like uniformly random roots do
+constexpr static unsigned int PLACEMENT_SET_COUNT = 8;
+
+// Geometric LOD tiers the culling pass sorts visible blades into, each drawn with its own indirect draw
+enum BladeLod : uint32_t {
+    BLADE_LOD_TESSELLATED = 0,  // grass.tesc/tese, one patch per blade
+    BLADE_LOD_LOW_POLY,         // grass_strip.vert, a fixed triangle strip
+    BLADE_LOD_IMPOSTOR,         // grass_impostor.vert/frag, a card standing in for a clump
+    BLADE_LOD_COUNT
+};
+
+// Segments in a low-poly blade, and the vertices each tier draws per blade
+constexpr static unsigned int LOW_POLY_SEGMENTS = 2;
+// Segments of the nearest tier when it is drawn without tessellation
+constexpr static unsigned int NEAR_STRIP_SEGMENTS = 4;
+constexpr static uint32_t BLADE_LOD_VERTEX_COUNTS[BLADE_LOD_COUNT] = { 1, 2 * LOW_POLY_SEGMENTS + 1, 4 };
+
+// Each tier is split at the middle of its distance range so near blades are drawn first and fill depth early.
+// Near blades fill the tier's range from the front, far blades from the back, and each half has its own indirect draw
+// at index lod * BLADE_DEPTH_BIN_COUNT + bin.
+enum BladeDepthBin : uint32_t {
+    BLADE_DEPTH_NEAR = 0,
+    BLADE_DEPTH_FAR,
+    BLADE_DEPTH_BIN_COUNT
+};
+constexpr static uint32_t BLADE_DRAW_COUNT = BLADE_LOD_COUNT * BLADE_DEPTH_BIN_COUNT;
+
+// What never changes about a simulated blade, 24 bytes, matching Blade in shaders/blade.glsl.
+// Only written when the blade is generated, the simulation reads it.
 struct Blade {
-    // Position and direction
-    glm::vec4 v0;
-    // Bezier point and height
-    glm::vec4 v1;
-    // Physical model guide and width
-    glm::vec4 v2;
-    // Up vector and stiffness coefficient
-    glm::vec4 up;
-
-    // Specify vertex input binding description
+    // Root position, in full precision so chunks far from the origin stay exact
+    glm::vec3 v0;
+    // Up vector, octahedral with 16 bit snorm components
+    uint32_t up;
+    // Halves: direction, width, stiffness coefficient and height
+    glm::uvec2 attributes;
+
+    static Blade Pack(glm::vec3 root, glm::vec3 up, float direction, float height, float width, float stiffness);
+};
+
+// What the simulation moves, 16 bytes, matching BladeState in shaders/blade.glsl. Awake blades derive the Bezier
+// point from the guide every frame; its height is stored so sleeping blades don't have to.
+struct BladeState {
+    // Halves: physical model guide relative to the root, and the wind direction the blade came to rest in, negative
+    // while it is moving (see compute.comp)
+    glm::uvec2 v2;
+    // Height of the length-corrected Bezier point above the root, along the up vector
+    float bend;
+    uint32_t padding;
+
+    static BladeState Pack(glm::vec3 guide);
+};
+
+// A blade that survived culling, 32 bytes, matching CulledBlade in shaders/blade.glsl.
+// The halves are decoded by the vertex fetch, the grass vertex stages only unpack the orientation.
+struct CulledBlade {
+    // Root position
+    glm::vec3 v0;
+    // Direction in the low 16 bits as unorm over a full turn, octahedral up vector in the high 16 as 8 bit snorm
+    uint32_t orientation;
+    // Halves: Bezier point relative to the root, and the packed tessellation levels
+    glm::uvec2 v1;
+    // Halves: physical model guide relative to the root, and width
+    glm::uvec2 v2;
+
+    // Specify vertex input binding description, every grass pipeline draws one blade per instance
     static vk::VertexInputBindingDescription getBindingDescription() {
         vk::VertexInputBindingDescription bindingDescription;
         bindingDescription.setBinding(0);
-        bindingDescription.setStride(sizeof(Blade));
-        bindingDescription.setInputRate(vk::VertexInputRate::eVertex);
+        bindingDescription.setStride(sizeof(CulledBlade));
+        bindingDescription.setInputRate(vk::VertexInputRate::eInstance);
 
         return bindingDescription;
     }
@@ -38,31 +113,33 @@ struct Blade {
         // v0
         attributeDescriptions[0].setBinding(0);
         attributeDescriptions[0].setLocation(0);
-        attributeDescriptions[0].setFormat(vk::Format::eR32G32B32A32Sfloat);
-        attributeDescriptions[0].setOffset(offsetof(Blade, v0));
+        attributeDescriptions[0].setFormat(vk::Format::eR32G32B32Sfloat);
+        attributeDescriptions[0].setOffset(offsetof(CulledBlade, v0));
 
         // v1
         attributeDescriptions[1].setBinding(0);
         attributeDescriptions[1].setLocation(1);
-        attributeDescriptions[1].setFormat(vk::Format::eR32G32B32A32Sfloat);
-        attributeDescriptions[1].setOffset(offsetof(Blade, v1));
+        attributeDescriptions[1].setFormat(vk::Format::eR16G16B16A16Sfloat);
+        attributeDescriptions[1].setOffset(offsetof(CulledBlade, v1));
 
         // v2
         attributeDescriptions[2].setBinding(0);
         attributeDescriptions[2].setLocation(2);
-        attributeDescriptions[2].setFormat(vk::Format::eR32G32B32A32Sfloat);
-        attributeDescriptions[2].setOffset(offsetof(Blade, v2));
+        attributeDescriptions[2].setFormat(vk::Format::eR16G16B16A16Sfloat);
+        attributeDescriptions[2].setOffset(offsetof(CulledBlade, v2));
 
-        // up
+        // orientation
         attributeDescriptions[3].setBinding(0);
         attributeDescriptions[3].setLocation(3);
-        attributeDescriptions[3].setFormat(vk::Format::eR32G32B32A32Sfloat);
-        attributeDescriptions[3].setOffset(offsetof(Blade, up));
+        attributeDescriptions[3].setFormat(vk::Format::eR32Uint);
+        attributeDescriptions[3].setOffset(offsetof(CulledBlade, orientation));
 
         return attributeDescriptions;
     }
 };
 
+static_assert(sizeof(Blade) == 24 && sizeof(BladeState) == 16 && sizeof(CulledBlade) == 32, "Blade layouts must match shaders/blade.glsl");
+
 struct BladeDrawIndirect {
     uint32_t vertexCount;
     uint32_t instanceCount;
@@ -70,20 +147,78 @@ struct BladeDrawIndirect {
     uint32_t firstInstance;
 };
 
+// A contiguous range of blades and the box they can sway within
+struct BladeTile {
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+    uint32_t firstBlade;
+    uint32_t bladeCount;
+    uint32_t padding[2];
+};
+
+struct BladeDispatchIndirect {
+    uint32_t x;
+    uint32_t y;
+    uint32_t z;
+};
+
 class Blades : public Model {
 private:
     vk::Buffer bladesBuffer;
+    vk::Buffer bladeStatesBuffer;
     vk::Buffer culledBladesBuffer;
     vk::Buffer numBladesBuffer;
+    vk::Buffer tilesBuffer;
+    vk::Buffer visibleTilesBuffer;
+    vk::Buffer dispatchIndirectBuffer;
 
     vk::DeviceMemory bladesBufferMemory;
+    vk::DeviceMemory bladeStatesBufferMemory;
     vk::DeviceMemory culledBladesBufferMemory;
     vk::DeviceMemory numBladesBufferMemory;
+    vk::DeviceMemory tilesBufferMemory;
+    vk::DeviceMemory visibleTilesBufferMemory;
+    vk::DeviceMemory dispatchIndirectBufferMemory;
+
+    // Patches of NUM_BLADES blades and NUM_TILES tiles, laid out back to back and culled and drawn together
+    uint32_t patchCount;
+
+    void CreateBuffers(vk::CommandPool commandPool, Blade* blades, BladeState* states, BladeTile* tiles);
 
 public:
-    Blades(Device* device, vk::CommandPool commandPool, float planeDim);
+    // A single planeDim x planeDim patch centered on the origin, on the terrain if there is one
+    Blades(Device* device, vk::CommandPool commandPool, float planeDim, const Terrain* terrain = nullptr);
+    // patchCount empty patches, for streamed chunks that fill their range of the blades and tiles buffers later,
+    // e.g. with a BladeGenerator. Their tiles hold no blades until then.
+    Blades(Device* device, vk::CommandPool commandPool, uint32_t patchCount);
+
+    // Fills NUM_BLADES blades and their upright starting states, BLADES_PER_TILE to a tile, and NUM_TILES tiles
+    // for a planeDim x planeDim square around center.
+    // Tile i covers cell GetTileCell(i) and its blades start at i * BLADES_PER_TILE.
+    // Blades are rooted on the terrain and grow along its normal, or stand on y = 0 without one.
+    // The same seed always gives the same field. Touches no Vulkan state, so it can run on any thread.
+    static void Generate(float planeDim, glm::vec2 center, uint32_t seed, const Terrain* terrain, Blade* blades, BladeState* states, BladeTile* tiles);
+
+    // PLACEMENT_SET_COUNT sets of BLADES_PER_TILE blade roots in the unit square, see BlueNoise::GenerateTileSets.
+    // Generated on first use and shared by Generate and generate.comp.
+    static const std::vector<glm::vec2>& GetPlacementSets();
+
+    // Column and row of a tile's cell in the TILE_GRID_DIM x TILE_GRID_DIM grid, matching tileCell in generate.comp
+    static glm::uvec2 GetTileCell(uint32_t tile);
+    // Interleaves the low 16 bits of x and z, x in the even bits, matching mortonCode in generate.comp
+    static uint32_t MortonCode(uint32_t x, uint32_t z);
+
+    uint32_t GetPatchCount() const;
+    // Blades and tiles across all patches; each LOD tier of the culled blades holds GetBladeCount() CulledBlades
+    uint32_t GetBladeCount() const;
+    uint32_t GetTileCount() const;
+
     vk::Buffer GetBladesBuffer() const;
+    vk::Buffer GetBladeStatesBuffer() const;
     vk::Buffer GetCulledBladesBuffer() const;
     vk::Buffer GetNumBladesBuffer() const;
+    vk::Buffer GetTilesBuffer() const;
+    vk::Buffer GetVisibleTilesBuffer() const;
+    vk::Buffer GetDispatchIndirectBuffer() const;
     ~Blades();
 };
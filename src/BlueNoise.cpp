@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <limits>
+#include <random>
+#include "BlueNoise.h"
+
+namespace {
+    // Candidates drawn per point, more spreads the points more evenly at a quadratic cost
+    constexpr uint32_t CANDIDATE_COUNT = 16;
+
+    // Squared distance on the unit torus, so points near opposite edges count as neighbours
+    float wrappedDistance2(glm::vec2 a, glm::vec2 b) {
+        glm::vec2 d = glm::abs(a - b);
+        d = glm::min(d, 1.0f - d);
+        return glm::dot(d, d);
+    }
+}
+
+std::vector<glm::vec2> BlueNoise::GenerateTileSets(uint32_t pointsPerSet, uint32_t setCount, uint32_t seed) {
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+    std::vector<glm::vec2> points;
+    points.reserve(pointsPerSet * setCount);
+
+    // Mitchell's best candidate: each new point is the candidate farthest from the points placed before it
+    for (uint32_t set = 0; set < setCount; set++) {
+        size_t first = points.size();
+
+        for (uint32_t i = 0; i < pointsPerSet; i++) {
+            glm::vec2 best;
+            float bestDistance2 = -1.0f;
+
+            for (uint32_t candidate = 0; candidate < CANDIDATE_COUNT; candidate++) {
+                glm::vec2 point(distribution(engine), distribution(engine));
+
+                float nearest2 = std::numeric_limits<float>::max();
+                for (size_t j = first; j < points.size(); j++) {
+                    nearest2 = std::min(nearest2, wrappedDistance2(point, points[j]));
+                }
+
+                if (nearest2 > bestDistance2) {
+                    best = point;
+                    bestDistance2 = nearest2;
+                }
+            }
+
+            points.push_back(best);
+        }
+    }
+
+    return points;
+}
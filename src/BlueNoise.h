@@ -0,0 +1,12 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace BlueNoise {
+    // setCount independent sets of pointsPerSet points in [0, 1)^2, stored set after set. Each set is a Poisson-disk
+    // like distribution on the torus, so it tiles with itself without seams, and is ordered progressively: any
+    // prefix of a set is itself evenly spread, so thinning a set by dropping its tail keeps the even spacing.
+    // The same seed always gives the same sets.
+    std::vector<glm::vec2> GenerateTileSets(uint32_t pointsPerSet, uint32_t setCount, uint32_t seed);
+}
@@ -64,6 +64,15 @@ void BufferUtils::CopyBuffer(Device* device, vk::CommandPool commandPool, vk::Bu
 }
 
 void BufferUtils::CreateBufferFromData(Device* device, vk::CommandPool commandPool, void* bufferData, vk::DeviceSize bufferSize, vk::BufferUsageFlags bufferUsage, vk::Buffer& buffer, vk::DeviceMemory& bufferMemory) {
+    // Create the buffer
+    vk::BufferUsageFlags usage = vk::BufferUsageFlags(vk::BufferUsageFlagBits::eTransferDst) | bufferUsage;
+    vk::MemoryPropertyFlags flags(vk::MemoryPropertyFlagBits::eDeviceLocal);
+    BufferUtils::CreateBuffer(device, bufferSize, usage, flags, buffer, bufferMemory);
+
+    BufferUtils::UpdateBufferFromData(device, commandPool, bufferData, bufferSize, buffer);
+}
+
+void BufferUtils::UpdateBufferFromData(Device* device, vk::CommandPool commandPool, void* bufferData, vk::DeviceSize bufferSize, vk::Buffer buffer) {
     // Create the staging buffer
     vk::Buffer stagingBuffer;
     vk::DeviceMemory stagingBufferMemory;
@@ -77,11 +86,6 @@ void BufferUtils::CreateBufferFromData(Device* device, vk::CommandPool commandPo
     memcpy(data, bufferData, static_cast<size_t>(bufferSize));
     device->GetLogicalDevice().unmapMemory(stagingBufferMemory);
 
-    // Create the buffer
-    vk::BufferUsageFlags usage = vk::BufferUsageFlags(vk::BufferUsageFlagBits::eTransferDst) | bufferUsage;
-    vk::MemoryPropertyFlags flags(vk::MemoryPropertyFlagBits::eDeviceLocal);
-    BufferUtils::CreateBuffer(device, bufferSize, usage, flags, buffer, bufferMemory);
-
     // Copy data from staging to buffer
     BufferUtils::CopyBuffer(device, commandPool, stagingBuffer, buffer, bufferSize);
 
@@ -89,3 +93,25 @@ void BufferUtils::CreateBufferFromData(Device* device, vk::CommandPool commandPo
     device->GetLogicalDevice().destroyBuffer(stagingBuffer);
     device->GetLogicalDevice().freeMemory(stagingBufferMemory);
 }
+
+void BufferUtils::ReadBufferToData(Device* device, vk::CommandPool commandPool, vk::Buffer buffer, vk::DeviceSize bufferSize, void* bufferData) {
+    // Create the staging buffer
+    vk::Buffer stagingBuffer;
+    vk::DeviceMemory stagingBufferMemory;
+
+    vk::BufferUsageFlags stagingUsage(vk::BufferUsageFlagBits::eTransferDst);
+    vk::MemoryPropertyFlags stagingProperties(vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    BufferUtils::CreateBuffer(device, bufferSize, stagingUsage, stagingProperties, stagingBuffer, stagingBufferMemory);
+
+    // Copy data from buffer to staging
+    BufferUtils::CopyBuffer(device, commandPool, buffer, stagingBuffer, bufferSize);
+
+    // Read the staging buffer
+    void* data = device->GetLogicalDevice().mapMemory(stagingBufferMemory, 0, bufferSize);
+    memcpy(bufferData, data, static_cast<size_t>(bufferSize));
+    device->GetLogicalDevice().unmapMemory(stagingBufferMemory);
+
+    // No need for the staging buffer anymore
+    device->GetLogicalDevice().destroyBuffer(stagingBuffer);
+    device->GetLogicalDevice().freeMemory(stagingBufferMemory);
+}
@@ -7,4 +7,8 @@ namespace BufferUtils {
     void CreateBuffer(Device* device, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Buffer& buffer, vk::DeviceMemory& bufferMemory);
     void CopyBuffer(Device* device, vk::CommandPool commandPool, vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size);
     void CreateBufferFromData(Device* device, vk::CommandPool commandPool, void* bufferData, vk::DeviceSize bufferSize, vk::BufferUsageFlags bufferUsage, vk::Buffer& buffer, vk::DeviceMemory& bufferMemory);
+    // Overwrites the start of an existing transfer destination buffer through a staging copy, waits until it's done
+    void UpdateBufferFromData(Device* device, vk::CommandPool commandPool, void* bufferData, vk::DeviceSize bufferSize, vk::Buffer buffer);
+    // Copies the start of an existing transfer source buffer back to the host through a staging copy, waits until it's done
+    void ReadBufferToData(Device* device, vk::CommandPool commandPool, vk::Buffer buffer, vk::DeviceSize bufferSize, void* bufferData);
 }
@@ -16,6 +16,32 @@ Camera::Camera(Device* device, float aspectRatio) : device(device) {
 
     BufferUtils::CreateBuffer(device, sizeof(CameraBufferObject), vk::BufferUsageFlags(vk::BufferUsageFlagBits::eUniformBuffer), vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent), buffer, bufferMemory);
     mappedData = device->GetLogicalDevice().mapMemory(bufferMemory, 0, sizeof(CameraBufferObject));
+    UpdateBufferObject();
+}
+
+void Camera::UpdateBufferObject() {
+    glm::mat4 viewProjection = cameraBufferObject.projectionMatrix * cameraBufferObject.viewMatrix;
+    cameraBufferObject.viewProjectionMatrix = viewProjection;
+    cameraBufferObject.inverseViewMatrix = glm::inverse(cameraBufferObject.viewMatrix);
+    cameraBufferObject.eye = cameraBufferObject.inverseViewMatrix[3];
+
+    // Clip planes from the rows of the view-projection matrix, with Vulkan's 0 <= z <= w depth range
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+
+    glm::vec4* planes = cameraBufferObject.frustumPlanes;
+    planes[0] = rows[3] + rows[0];  // left
+    planes[1] = rows[3] - rows[0];  // right
+    planes[2] = rows[3] + rows[1];  // bottom
+    planes[3] = rows[3] - rows[1];  // top
+    planes[4] = rows[2];            // near
+    planes[5] = rows[3] - rows[2];  // far
+    for (int i = 0; i < 6; i++) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+
     memcpy(mappedData, &cameraBufferObject, sizeof(CameraBufferObject));
 }
 
@@ -23,6 +49,14 @@ vk::Buffer Camera::GetBuffer() const {
     return buffer;
 }
 
+glm::mat4 Camera::GetViewProjection() const {
+    return cameraBufferObject.viewProjectionMatrix;
+}
+
+glm::vec3 Camera::GetEye() const {
+    return glm::vec3(cameraBufferObject.eye);
+}
+
 void Camera::UpdateOrbit(float deltaX, float deltaY, float deltaZ) {
     theta += deltaX;
     phi += deltaY;
@@ -32,11 +66,21 @@ void Camera::UpdateOrbit(float deltaX, float deltaY, float deltaZ) {
     float radPhi = glm::radians(phi);
 
     glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), radTheta, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::rotate(glm::mat4(1.0f), radPhi, glm::vec3(1.0f, 0.0f, 0.0f));
-    glm::mat4 finalTransform = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f)) * rotation * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, r));
+    glm::mat4 finalTransform = glm::translate(glm::mat4(1.0f), target) * rotation * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, r));
 
     cameraBufferObject.viewMatrix = glm::inverse(finalTransform);
 
-    memcpy(mappedData, &cameraBufferObject, sizeof(CameraBufferObject));
+    UpdateBufferObject();
+}
+
+void Camera::Pan(float forward, float right) {
+    // The camera looks down -z rotated by theta around y
+    float radTheta = glm::radians(theta);
+    glm::vec3 forwardDir(-sin(radTheta), 0.0f, -cos(radTheta));
+    glm::vec3 rightDir(cos(radTheta), 0.0f, -sin(radTheta));
+    target += forwardDir * forward + rightDir * right;
+
+    UpdateOrbit(0.0f, 0.0f, 0.0f);
 }
 
 Camera::~Camera() {
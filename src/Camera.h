@@ -2,9 +2,16 @@
 #include <glm/glm.hpp>
 #include "Device.h"
 
+// Matches shaders/camera.glsl
 struct CameraBufferObject {
     glm::mat4 viewMatrix;
     glm::mat4 projectionMatrix;
+
+    // Derived from the two above whenever they change
+    glm::mat4 viewProjectionMatrix;
+    glm::mat4 inverseViewMatrix;
+    glm::vec4 eye;
+    glm::vec4 frustumPlanes[6];
 };
 
 class Camera {
@@ -19,12 +26,19 @@ private:
     void* mappedData;
 
     float r, theta, phi;
+    glm::vec3 target = glm::vec3(0.0f);  // point on the ground the camera orbits
+
+    void UpdateBufferObject();
 
 public:
     Camera(Device* device, float aspectRatio);
     ~Camera();
 
     vk::Buffer GetBuffer() const;
+    glm::mat4 GetViewProjection() const;
+    glm::vec3 GetEye() const;
     
     void UpdateOrbit(float deltaX, float deltaY, float deltaZ);
+    // Moves the orbit target along the ground, forward being the horizontal view direction
+    void Pan(float forward, float right);
 };
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <cstdio>
+#include "GrassStreamer.h"
+#include "Instance.h"
+
+namespace {
+    // The same chunk always regrows the same grass
+    uint32_t chunkSeed(glm::ivec2 chunk) {
+        return (static_cast<uint32_t>(chunk.x) * 73856093u) ^ (static_cast<uint32_t>(chunk.y) * 19349663u);
+    }
+}
+
+GrassStreamer::GrassStreamer(Device* device, Scene* scene, float chunkSize, int ringRadius)
+    : device(device), chunkSize(chunkSize), ringRadius(ringRadius) {
+    vk::Device logicalDevice = device->GetLogicalDevice();
+
+    if (!scene->GetTerrain()) {
+        throw std::runtime_error("Grass streaming needs a terrain to grow on");
+    }
+
+    for (int z = -ringRadius; z <= ringRadius; z++) {
+        for (int x = -ringRadius; x <= ringRadius; x++) {
+            ringOffsets.push_back(glm::ivec2(x, z));
+        }
+    }
+    std::stable_sort(ringOffsets.begin(), ringOffsets.end(), [](glm::ivec2 a, glm::ivec2 b) {
+        return a.x * a.x + a.y * a.y < b.x * b.x + b.y * b.y;
+    });
+
+    vk::CommandPoolCreateInfo poolInfo;
+    poolInfo.setQueueFamilyIndex(device->GetInstance()->GetQueueFamilyIndices()[QueueFlags::Compute]);
+    poolInfo.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
+
+    try {
+        commandPool = logicalDevice.createCommandPool(poolInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create grass streaming command pool");
+    }
+
+    vk::CommandBufferAllocateInfo allocInfo;
+    allocInfo.setCommandPool(commandPool);
+    allocInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+    allocInfo.setCommandBufferCount(1);
+    logicalDevice.allocateCommandBuffers(&allocInfo, &commandBuffer);
+
+    try {
+        fence = logicalDevice.createFence(vk::FenceCreateInfo());
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create grass streaming fence");
+    }
+
+    // One patch and slot per chunk in the ring, allocated once. Each update can clear or fill every patch.
+    pool = new Blades(device, commandPool, static_cast<uint32_t>(ringOffsets.size()));
+    scene->AddBlades(pool);
+    generator = new BladeGenerator(device, pool, scene->GetTerrain(), static_cast<uint32_t>(ringOffsets.size()));
+    slots.resize(ringOffsets.size());
+
+    // Simulated and culled blades and tiles per chunk, plus the pool's shared indirect arguments
+    vk::DeviceSize slotSize = NUM_BLADES * (sizeof(Blade) + sizeof(BladeState) + BLADE_LOD_COUNT * sizeof(CulledBlade)) + NUM_TILES * (sizeof(BladeTile) + sizeof(uint32_t));
+    vk::DeviceSize poolSize = slots.size() * slotSize + BLADE_DRAW_COUNT * sizeof(BladeDrawIndirect) + sizeof(BladeDispatchIndirect);
+    printf("Grass streaming: %zu chunks of %.1f x %.1f, %.1f MB\n", slots.size(), chunkSize, chunkSize, poolSize / (1024.0 * 1024.0));
+}
+
+bool GrassStreamer::Update(glm::vec3 eye) {
+    vk::Device logicalDevice = device->GetLogicalDevice();
+
+    // Move the ring with the camera; chunk (0, 0) is centered on the origin
+    glm::ivec2 previousCenter = centerChunk;
+    centerChunk = glm::ivec2(glm::floor(glm::vec2(eye.x, eye.z) / chunkSize + 0.5f));
+    bool changed = centerChunk != previousCenter;
+
+    // The request buffer is reused by the next batch, so wait for the last one without stalling the frame
+    if (inFlight) {
+        if (logicalDevice.getFenceStatus(fence) != vk::Result::eSuccess) {
+            return changed;
+        }
+        inFlight = false;
+    }
+
+    // Chunks that left the ring free their patch. Generation and the renderer's compute pass share the queue,
+    // so a patch can be refilled right away; frames submitted earlier still finish with the old blades.
+    bool queued = false;
+    std::vector<uint32_t> released;
+    for (uint32_t i = 0; i < slots.size(); i++) {
+        if (slots[i].resident && !InRing(slots[i].chunk)) {
+            slots[i].resident = false;
+            released.push_back(i);
+        }
+    }
+
+    // Grow every chunk of the ring that no slot holds yet
+    for (glm::ivec2 offset : ringOffsets) {
+        glm::ivec2 chunk = centerChunk + offset;
+
+        bool held = std::any_of(slots.begin(), slots.end(), [chunk](const Slot& slot) {
+            return slot.resident && slot.chunk == chunk;
+        });
+        if (held) {
+            continue;
+        }
+
+        // There is a slot per chunk of the ring, so one is always free
+        auto freeSlot = std::find_if(slots.begin(), slots.end(), [](const Slot& slot) { return !slot.resident; });
+        uint32_t index = static_cast<uint32_t>(freeSlot - slots.begin());
+        freeSlot->chunk = chunk;
+        freeSlot->resident = true;
+        generator->Generate(index, glm::vec2(chunk) * chunkSize, chunkSize, chunkSeed(chunk));
+        queued = true;
+    }
+
+    // Released patches that weren't refilled stop being simulated and drawn
+    for (uint32_t index : released) {
+        if (!slots[index].resident) {
+            generator->Clear(index);
+            queued = true;
+        }
+    }
+
+    if (!queued) {
+        return changed;
+    }
+
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.setFlags(vk::CommandBufferUsageFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    commandBuffer.begin(beginInfo);
+    generator->Record(commandBuffer);
+    commandBuffer.end();
+
+    vk::SubmitInfo submitInfo;
+    submitInfo.setCommandBufferCount(1);
+    submitInfo.setPCommandBuffers(&commandBuffer);
+
+    logicalDevice.resetFences(1, &fence);
+    try {
+        device->GetQueue(QueueFlags::Compute).submit(submitInfo, fence);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to submit grass chunk generation");
+    }
+    inFlight = true;
+
+    return changed;
+}
+
+glm::vec2 GrassStreamer::GetCenter() const {
+    return glm::vec2(centerChunk) * chunkSize;
+}
+
+bool GrassStreamer::InRing(glm::ivec2 chunk) const {
+    glm::ivec2 offset = chunk - centerChunk;
+    return std::abs(offset.x) <= ringRadius && std::abs(offset.y) <= ringRadius;
+}
+
+GrassStreamer::~GrassStreamer() {
+    vk::Device logicalDevice = device->GetLogicalDevice();
+    logicalDevice.destroyFence(fence);
+    logicalDevice.freeCommandBuffers(commandPool, 1, &commandBuffer);
+    logicalDevice.destroyCommandPool(commandPool);
+
+    delete generator;
+    delete pool;
+}
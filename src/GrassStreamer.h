@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Device.h"
+#include "Scene.h"
+#include "BladeGenerator.h"
+
+// Keeps the grass chunks in a ring around the camera resident in one Blades pool with a patch per chunk.
+// Chunks are grown straight into their patch by a BladeGenerator on the compute queue and cleared once they
+// leave the ring, so memory and per-frame cost stay constant however far the camera travels.
+// Chunks only ever change the contents of the pool, never its buffers, so the renderer's commands stay valid.
+class GrassStreamer {
+public:
+    GrassStreamer() = delete;
+    // Adds Blades with (2 * ringRadius + 1)^2 empty patches to the scene, each holding one chunkSize x chunkSize chunk at a time.
+    // Chunks grow on the scene's terrain, which must be set.
+    GrassStreamer(Device* device, Scene* scene, float chunkSize, int ringRadius);
+    ~GrassStreamer();
+
+    // Clears chunks that left the ring and generates the missing ones. Call once per frame, before the renderer's,
+    // so the generation is submitted ahead of the frame's compute pass. Returns true when the ring moved.
+    bool Update(glm::vec3 eye);
+
+    // Center of the chunk the camera was in at the last update
+    glm::vec2 GetCenter() const;
+
+private:
+    // Slot i owns patch i of the pool
+    struct Slot {
+        glm::ivec2 chunk;
+        bool resident = false;  // holds chunk, or will once the submitted generation has run
+    };
+
+    bool InRing(glm::ivec2 chunk) const;
+
+    Device* device;
+    float chunkSize;
+    int ringRadius;
+    glm::ivec2 centerChunk = glm::ivec2(0);
+
+    // Offsets of the chunks in the ring, nearest first so the area around the camera fills in first
+    std::vector<glm::ivec2> ringOffsets;
+
+    Blades* pool;
+    BladeGenerator* generator;
+    std::vector<Slot> slots;
+
+    // Generation commands, re-recorded once the previous batch completed
+    vk::CommandPool commandPool;
+    vk::CommandBuffer commandBuffer;
+    vk::Fence fence;
+    bool inFlight = false;
+};
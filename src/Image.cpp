@@ -7,11 +7,15 @@
 #include "BufferUtils.h"
 
 void Image::Create(Device* device, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Image& image, vk::DeviceMemory& imageMemory) {
+    Image::Create(device, width, height, 1, format, tiling, usage, properties, image, imageMemory);
+}
+
+void Image::Create(Device* device, uint32_t width, uint32_t height, uint32_t mipLevels, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Image& image, vk::DeviceMemory& imageMemory) {
     // Create Vulkan image
     vk::ImageCreateInfo imageInfo;
     imageInfo.setImageType(vk::ImageType::e2D);
     imageInfo.setExtent(vk::Extent3D(width, height, 1));
-    imageInfo.setMipLevels(1);
+    imageInfo.setMipLevels(mipLevels);
     imageInfo.setArrayLayers(1);
     imageInfo.setFormat(format);
     imageInfo.setTiling(tiling);
@@ -45,6 +49,10 @@ void Image::Create(Device* device, uint32_t width, uint32_t height, vk::Format f
 }
 
 void Image::TransitionLayout(Device* device, vk::CommandPool commandPool, vk::Image image, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
+    Image::TransitionLayout(device, commandPool, image, format, 1, oldLayout, newLayout);
+}
+
+void Image::TransitionLayout(Device* device, vk::CommandPool commandPool, vk::Image image, vk::Format format, uint32_t mipLevels, vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
     auto hasStencilComponent = [](vk::Format format) {
         return format == vk::Format::eD32SfloatS8Uint || format == vk::Format::eD24UnormS8Uint;
     };
@@ -69,7 +77,7 @@ void Image::TransitionLayout(Device* device, vk::CommandPool commandPool, vk::Im
     }
   
     barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.levelCount = mipLevels;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
   
@@ -95,6 +103,12 @@ void Image::TransitionLayout(Device* device, vk::CommandPool commandPool, vk::Im
     
         sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
         destinationStage = vk::PipelineStageFlagBits::eEarlyFragmentTests;
+    } else if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eGeneral) {
+        barrier.setSrcAccessMask(vk::AccessFlagBits(0));
+        barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+        sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
+        destinationStage = vk::PipelineStageFlagBits::eComputeShader;
     } else {
         throw std::invalid_argument("Unsupported layout transition");
     }
@@ -126,6 +140,10 @@ void Image::TransitionLayout(Device* device, vk::CommandPool commandPool, vk::Im
 }
 
 vk::ImageView Image::CreateView(Device* device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags) {
+    return Image::CreateView(device, image, format, aspectFlags, 1);
+}
+
+vk::ImageView Image::CreateView(Device* device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels) {
     vk::ImageViewCreateInfo viewInfo;
     viewInfo.setImage(image);
     viewInfo.setViewType(vk::ImageViewType::e2D);
@@ -134,7 +152,7 @@ vk::ImageView Image::CreateView(Device* device, vk::Image image, vk::Format form
     // Describe the image's purpose and which part of the image should be accessed
     viewInfo.subresourceRange.aspectMask = aspectFlags;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
@@ -164,6 +182,10 @@ void Image::CopyFromBuffer(Device* device, vk::CommandPool commandPool, vk::Buff
     region.setImageOffset(vk::Offset3D{ 0, 0, 0 });
     region.setImageExtent(vk::Extent3D{ width, height, 1 });
 
+    Image::CopyFromBuffer(device, commandPool, buffer, image, std::vector<vk::BufferImageCopy>{ region });
+}
+
+void Image::CopyFromBuffer(Device* device, vk::CommandPool commandPool, vk::Buffer buffer, vk::Image& image, const std::vector<vk::BufferImageCopy>& regions) {
     vk::CommandBufferAllocateInfo allocInfo;
     allocInfo.setLevel(vk::CommandBufferLevel::ePrimary);
     allocInfo.setCommandPool(commandPool);
@@ -177,7 +199,7 @@ void Image::CopyFromBuffer(Device* device, vk::CommandPool commandPool, vk::Buff
     
     commandBuffer.begin(beginInfo);
    
-    commandBuffer.copyBufferToImage(buffer, image, vk::ImageLayout::eTransferDstOptimal, 1, &region);
+    commandBuffer.copyBufferToImage(buffer, image, vk::ImageLayout::eTransferDstOptimal, static_cast<uint32_t>(regions.size()), regions.data());
 
     commandBuffer.end();
 
@@ -1,3 +1,4 @@
+#include <cstring>
 #include "Model.h"
 #include "BufferUtils.h"
 #include "Image.h"
@@ -13,8 +14,11 @@ Model::Model(Device* device, vk::CommandPool commandPool, const std::vector<Vert
         BufferUtils::CreateBufferFromData(device, commandPool, this->indices.data(), indices.size() * sizeof(uint32_t), vk::BufferUsageFlagBits::eIndexBuffer, indexBuffer, indexBufferMemory);
     }
 
+    // Host-visible like the camera buffer, so moving a model is a write rather than a transfer the device has to idle for
     modelBufferObject.modelMatrix = glm::mat4(1.0f);
-    BufferUtils::CreateBufferFromData(device, commandPool, &modelBufferObject, sizeof(ModelBufferObject), vk::BufferUsageFlagBits::eUniformBuffer, modelBuffer, modelBufferMemory);
+    BufferUtils::CreateBuffer(device, sizeof(ModelBufferObject), vk::BufferUsageFlags(vk::BufferUsageFlagBits::eUniformBuffer), vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent), modelBuffer, modelBufferMemory);
+    mappedModelData = device->GetLogicalDevice().mapMemory(modelBufferMemory, 0, sizeof(ModelBufferObject));
+    memcpy(mappedModelData, &modelBufferObject, sizeof(ModelBufferObject));
 }
 
 Model::~Model() {
@@ -28,6 +32,7 @@ Model::~Model() {
         device->GetLogicalDevice().freeMemory(vertexBufferMemory);
     }
 
+    device->GetLogicalDevice().unmapMemory(modelBufferMemory);
     device->GetLogicalDevice().destroyBuffer(modelBuffer);
     device->GetLogicalDevice().freeMemory(modelBufferMemory);
 
@@ -41,8 +46,12 @@ Model::~Model() {
 }
 
 void Model::SetTexture(vk::Image texture) {
+    SetTexture(texture, vk::Format::eR8G8B8A8Unorm, 1);
+}
+
+void Model::SetTexture(vk::Image texture, vk::Format format, uint32_t mipLevels) {
     this->texture = texture;
-    this->textureView = Image::CreateView(device, texture, vk::Format::eR8G8B8A8Unorm, vk::ImageAspectFlagBits::eColor);
+    this->textureView = Image::CreateView(device, texture, format, vk::ImageAspectFlagBits::eColor, mipLevels);
 
     // --- Specify all filters and transformations ---
     vk::SamplerCreateInfo samplerInfo;
@@ -74,7 +83,7 @@ void Model::SetTexture(vk::Image texture) {
     samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eLinear);
     samplerInfo.setMipLodBias(0.0f);
     samplerInfo.setMinLod(0.0f);
-    samplerInfo.setMaxLod(0.0f);
+    samplerInfo.setMaxLod(static_cast<float>(mipLevels - 1));
 
     try {
         textureSampler = device->GetLogicalDevice().createSampler(samplerInfo);
@@ -84,6 +93,11 @@ void Model::SetTexture(vk::Image texture) {
     }
 }
 
+void Model::SetModelMatrix(const glm::mat4& modelMatrix) {
+    modelBufferObject.modelMatrix = modelMatrix;
+    memcpy(mappedModelData, &modelBufferObject, sizeof(ModelBufferObject));
+}
+
 const std::vector<Vertex>& Model::getVertices() const {
     return vertices;
 }
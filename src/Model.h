@@ -24,6 +24,7 @@ protected:
     vk::Buffer modelBuffer;
     vk::DeviceMemory modelBufferMemory;
     ModelBufferObject modelBufferObject;
+    void* mappedModelData;
 
     vk::Image texture;
     vk::ImageView textureView;
@@ -35,6 +36,10 @@ public:
     virtual ~Model();
 
     void SetTexture(vk::Image texture);
+    void SetTexture(vk::Image texture, vk::Format format, uint32_t mipLevels);
+
+    // Writes the mapped model buffer, so frames submitted from then on see the new matrix
+    void SetModelMatrix(const glm::mat4& modelMatrix);
 
     const std::vector<Vertex>& getVertices() const;
 
@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
 #include "Renderer.h"
 #include "Instance.h"
 #include "ShaderModule.h"
@@ -5,8 +10,35 @@
 #include "Blades.h"
 #include "Camera.h"
 #include "Image.h"
-
-static constexpr unsigned int WORKGROUP_SIZE = 32;
+#include "BufferUtils.h"
+
+#ifdef PIPELINE_STATISTICS
+static constexpr bool ENABLE_PIPELINE_STATISTICS = true;
+#else
+static constexpr bool ENABLE_PIPELINE_STATISTICS = false;
+#endif
+
+// Counters gathered by the statistics queries, in the order Vulkan writes their results (ascending bit value)
+struct PipelineStatistic {
+    vk::QueryPipelineStatisticFlagBits flag;
+    const char* name;
+    bool tessellation;
+};
+static const PipelineStatistic PIPELINE_STATISTICS_COUNTERS[] = {
+    { vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations, "vertex", false },
+    { vk::QueryPipelineStatisticFlagBits::eClippingInvocations, "clipping in", false },
+    { vk::QueryPipelineStatisticFlagBits::eClippingPrimitives, "clipping out", false },
+    { vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations, "fragment", false },
+    { vk::QueryPipelineStatisticFlagBits::eTessellationControlShaderPatches, "TCS patches", true },
+    { vk::QueryPipelineStatisticFlagBits::eTessellationEvaluationShaderInvocations, "TES", true },
+};
+
+// Workgroup sizes tried by the compute auto-tuner, and how many dispatches each one is timed over
+static constexpr uint32_t WORKGROUP_SIZE_CANDIDATES[] = { 32, 64, 128, 256 };
+static constexpr uint32_t TUNE_ITERATIONS = 16;
+
+// Frames averaged into each grass timing printout
+static constexpr uint32_t GRASS_TIMING_FRAMES = 256;
 
 Renderer::Renderer(Device* device, SwapChain* swapChain, Scene* scene, Camera* camera)
   : device(device),
@@ -15,15 +47,34 @@ Renderer::Renderer(Device* device, SwapChain* swapChain, Scene* scene, Camera* c
     scene(scene),
     camera(camera) {
 
+    // main enables tessellation whenever the device has it; without it only strips can be drawn
+    tessellationSupported = device->GetInstance()->GetPhysicalDevice().getFeatures().tessellationShader == VK_TRUE;
+    if (!tessellationSupported) {
+        grassGeometry = GrassGeometry::Strips;
+    }
+
+    // Far depth bins are drawn from a nonzero first instance
+    depthBinningSupported = device->GetInstance()->GetPhysicalDevice().getFeatures().drawIndirectFirstInstance == VK_TRUE;
+    if (!depthBinningSupported) {
+        computeConstants.depthBinning = VK_FALSE;
+    }
+
+    // The depth bins of a tier are drawn with one call when main enabled multiDrawIndirect
+    multiDrawIndirectSupported = device->GetInstance()->GetPhysicalDevice().getFeatures().multiDrawIndirect == VK_TRUE;
+
     CreateCommandPools();
     CreateRenderPass();
     CreateCameraDescriptorSetLayout();
     CreateModelDescriptorSetLayout();
+    CreateTerrainDescriptorSetLayout();
     CreateTimeDescriptorSetLayout();
     CreateComputeDescriptorSetLayout();
+    CreateOcclusionDescriptorSetLayouts();
+    CreateOcclusionResources();
     CreateDescriptorPool();
     CreateCameraDescriptorSet();
     CreateModelDescriptorSets();
+    CreateTerrainDescriptorSet();
     CreateGrassDescriptorSets();
     CreateTimeDescriptorSet();
     CreateComputeDescriptorSets();
@@ -31,8 +82,14 @@ Renderer::Renderer(Device* device, SwapChain* swapChain, Scene* scene, Camera* c
     CreateGraphicsPipeline();
     CreateGrassPipeline();
     CreateComputePipeline();
+    CreateHiZPipeline();
+    UpdateNearTierVertexCount();
     RecordCommandBuffers();
     RecordComputeCommandBuffer();
+
+    if (ENABLE_SHADER_HOT_RELOAD) {
+        WatchShaders();
+    }
 }
 
 void Renderer::CreateCommandPools() {
@@ -80,16 +137,17 @@ void Renderer::CreateRenderPass() {
     // Depth buffer attachment
     vk::Format depthFormat = device->GetInstance()->GetSupportedFormat({ vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint }, 
                                                                         vk::ImageTiling::eOptimal, 
-                                                                        vk::FormatFeatureFlags(vk::FormatFeatureFlagBits::eDepthStencilAttachment));
+                                                                        vk::FormatFeatureFlags(vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage));
     vk::AttachmentDescription depthAttachment;
     depthAttachment.setFormat(depthFormat);
     depthAttachment.setSamples(vk::SampleCountFlagBits::e1);
     depthAttachment.setLoadOp(vk::AttachmentLoadOp::eClear);
-    depthAttachment.setStoreOp(vk::AttachmentStoreOp::eDontCare);
+    depthAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
     depthAttachment.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
     depthAttachment.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
     depthAttachment.setInitialLayout(vk::ImageLayout::eUndefined);
-    depthAttachment.setFinalLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+    // Kept after the pass and read when building the Hi-Z pyramid
+    depthAttachment.setFinalLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal);
 
     // Create a depth attachment reference
     vk::AttachmentReference depthAttachmentRef;
@@ -109,10 +167,22 @@ void Renderer::CreateRenderPass() {
     vk::SubpassDependency dependency;
     dependency.setSrcSubpass(VK_SUBPASS_EXTERNAL);
     dependency.setDstSubpass(0);
-    dependency.setSrcStageMask(vk::PipelineStageFlags(vk::PipelineStageFlagBits::eColorAttachmentOutput));
+    // The previous frame's Hi-Z pass still reads the depth image that this pass clears
+    dependency.setSrcStageMask(vk::PipelineStageFlags(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eComputeShader));
     dependency.setSrcAccessMask(vk::AccessFlags(0));
-    dependency.setDstStageMask(vk::PipelineStageFlags(vk::PipelineStageFlagBits::eColorAttachmentOutput));
-    dependency.setDstAccessMask(vk::AccessFlags(vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite));
+    dependency.setDstStageMask(vk::PipelineStageFlags(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests));
+    dependency.setDstAccessMask(vk::AccessFlags(vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite));
+
+    // Depth writes must land before the Hi-Z pass samples them
+    vk::SubpassDependency depthDependency;
+    depthDependency.setSrcSubpass(0);
+    depthDependency.setDstSubpass(VK_SUBPASS_EXTERNAL);
+    depthDependency.setSrcStageMask(vk::PipelineStageFlags(vk::PipelineStageFlagBits::eLateFragmentTests));
+    depthDependency.setSrcAccessMask(vk::AccessFlags(vk::AccessFlagBits::eDepthStencilAttachmentWrite));
+    depthDependency.setDstStageMask(vk::PipelineStageFlags(vk::PipelineStageFlagBits::eComputeShader));
+    depthDependency.setDstAccessMask(vk::AccessFlags(vk::AccessFlagBits::eShaderRead));
+
+    std::array<vk::SubpassDependency, 2> dependencies = { dependency, depthDependency };
 
     // Create render pass
     vk::RenderPassCreateInfo renderPassInfo;
@@ -120,8 +190,8 @@ void Renderer::CreateRenderPass() {
     renderPassInfo.setPAttachments(attachments.data());
     renderPassInfo.setSubpassCount(1);
     renderPassInfo.setPSubpasses(&subpass);
-    renderPassInfo.setDependencyCount(1);
-    renderPassInfo.setPDependencies(&dependency);
+    renderPassInfo.setDependencyCount(static_cast<uint32_t>(dependencies.size()));
+    renderPassInfo.setPDependencies(dependencies.data());
 
     try {
         renderPass = logicalDevice.createRenderPass(renderPassInfo);
@@ -185,6 +255,43 @@ void Renderer::CreateModelDescriptorSetLayout() {
     }
 }
 
+void Renderer::CreateTerrainDescriptorSetLayout() {
+    // A model's buffer and texture, plus the height and normal map the grid is displaced with
+    vk::DescriptorSetLayoutBinding uboLayoutBinding;
+    uboLayoutBinding.setBinding(0);
+    uboLayoutBinding.setDescriptorType(vk::DescriptorType::eUniformBuffer);
+    uboLayoutBinding.setDescriptorCount(1);
+    uboLayoutBinding.setStageFlags(vk::ShaderStageFlags(vk::ShaderStageFlagBits::eVertex));
+    uboLayoutBinding.setPImmutableSamplers(nullptr);
+
+    vk::DescriptorSetLayoutBinding samplerLayoutBinding;
+    samplerLayoutBinding.setBinding(1);
+    samplerLayoutBinding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    samplerLayoutBinding.setDescriptorCount(1);
+    samplerLayoutBinding.setStageFlags(vk::ShaderStageFlags(vk::ShaderStageFlagBits::eFragment));
+    samplerLayoutBinding.setPImmutableSamplers(nullptr);
+
+    vk::DescriptorSetLayoutBinding mapLayoutBinding;
+    mapLayoutBinding.setBinding(2);
+    mapLayoutBinding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    mapLayoutBinding.setDescriptorCount(1);
+    mapLayoutBinding.setStageFlags(vk::ShaderStageFlags(vk::ShaderStageFlagBits::eVertex));
+    mapLayoutBinding.setPImmutableSamplers(nullptr);
+
+    std::vector<vk::DescriptorSetLayoutBinding> bindings = { uboLayoutBinding, samplerLayoutBinding, mapLayoutBinding };
+
+    vk::DescriptorSetLayoutCreateInfo layoutInfo;
+    layoutInfo.setBindingCount(static_cast<uint32_t>(bindings.size()));
+    layoutInfo.setPBindings(bindings.data());
+
+    try {
+        terrainDescriptorSetLayout = logicalDevice.createDescriptorSetLayout(layoutInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create terrain descriptor set layout");
+    }
+}
+
 void Renderer::CreateTimeDescriptorSetLayout() {
     // Describe the binding of the descriptor set layout
     vk::DescriptorSetLayoutBinding uboLayoutBinding;
@@ -233,7 +340,35 @@ void Renderer::CreateComputeDescriptorSetLayout() {
     numBladesBinding.setStageFlags(vk::ShaderStageFlags(vk::ShaderStageFlagBits::eCompute));
     numBladesBinding.setPImmutableSamplers(nullptr);
 
-    std::array<vk::DescriptorSetLayoutBinding, 3> bindings = { bladesBinding, culledBladesBinding, numBladesBinding };
+    vk::DescriptorSetLayoutBinding tilesBinding;
+    tilesBinding.setBinding(3);
+    tilesBinding.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    tilesBinding.setDescriptorCount(1);
+    tilesBinding.setStageFlags(vk::ShaderStageFlags(vk::ShaderStageFlagBits::eCompute));
+    tilesBinding.setPImmutableSamplers(nullptr);
+
+    vk::DescriptorSetLayoutBinding visibleTilesBinding;
+    visibleTilesBinding.setBinding(4);
+    visibleTilesBinding.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    visibleTilesBinding.setDescriptorCount(1);
+    visibleTilesBinding.setStageFlags(vk::ShaderStageFlags(vk::ShaderStageFlagBits::eCompute));
+    visibleTilesBinding.setPImmutableSamplers(nullptr);
+
+    vk::DescriptorSetLayoutBinding dispatchIndirectBinding;
+    dispatchIndirectBinding.setBinding(5);
+    dispatchIndirectBinding.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    dispatchIndirectBinding.setDescriptorCount(1);
+    dispatchIndirectBinding.setStageFlags(vk::ShaderStageFlags(vk::ShaderStageFlagBits::eCompute));
+    dispatchIndirectBinding.setPImmutableSamplers(nullptr);
+
+    vk::DescriptorSetLayoutBinding bladeStatesBinding;
+    bladeStatesBinding.setBinding(6);
+    bladeStatesBinding.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    bladeStatesBinding.setDescriptorCount(1);
+    bladeStatesBinding.setStageFlags(vk::ShaderStageFlags(vk::ShaderStageFlagBits::eCompute));
+    bladeStatesBinding.setPImmutableSamplers(nullptr);
+
+    std::array<vk::DescriptorSetLayoutBinding, 7> bindings = { bladesBinding, culledBladesBinding, numBladesBinding, tilesBinding, visibleTilesBinding, dispatchIndirectBinding, bladeStatesBinding };
     vk::DescriptorSetLayoutCreateInfo layoutCreateInfo;
     layoutCreateInfo.setBindingCount(static_cast<uint32_t>(bindings.size()));
     layoutCreateInfo.setPBindings(bindings.data());
@@ -246,6 +381,99 @@ void Renderer::CreateComputeDescriptorSetLayout() {
     }
 }
 
+void Renderer::CreateOcclusionDescriptorSetLayouts() {
+    // Hi-Z build: the level above (or the depth buffer) and the level being written
+    vk::DescriptorSetLayoutBinding srcDepthBinding;
+    srcDepthBinding.setBinding(0);
+    srcDepthBinding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    srcDepthBinding.setDescriptorCount(1);
+    srcDepthBinding.setStageFlags(vk::ShaderStageFlags(vk::ShaderStageFlagBits::eCompute));
+    srcDepthBinding.setPImmutableSamplers(nullptr);
+
+    vk::DescriptorSetLayoutBinding dstDepthBinding;
+    dstDepthBinding.setBinding(1);
+    dstDepthBinding.setDescriptorType(vk::DescriptorType::eStorageImage);
+    dstDepthBinding.setDescriptorCount(1);
+    dstDepthBinding.setStageFlags(vk::ShaderStageFlags(vk::ShaderStageFlagBits::eCompute));
+    dstDepthBinding.setPImmutableSamplers(nullptr);
+
+    std::array<vk::DescriptorSetLayoutBinding, 2> hiZBindings = { srcDepthBinding, dstDepthBinding };
+    vk::DescriptorSetLayoutCreateInfo hiZLayoutInfo;
+    hiZLayoutInfo.setBindingCount(static_cast<uint32_t>(hiZBindings.size()));
+    hiZLayoutInfo.setPBindings(hiZBindings.data());
+
+    try {
+        hiZDescriptorSetLayout = logicalDevice.createDescriptorSetLayout(hiZLayoutInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create Hi-Z descriptor set layout");
+    }
+
+    // Occlusion test in the culling passes: reprojection uniforms and the whole pyramid
+    vk::DescriptorSetLayoutBinding occlusionUboBinding;
+    occlusionUboBinding.setBinding(0);
+    occlusionUboBinding.setDescriptorType(vk::DescriptorType::eUniformBuffer);
+    occlusionUboBinding.setDescriptorCount(1);
+    occlusionUboBinding.setStageFlags(vk::ShaderStageFlags(vk::ShaderStageFlagBits::eCompute));
+    occlusionUboBinding.setPImmutableSamplers(nullptr);
+
+    vk::DescriptorSetLayoutBinding hiZBinding;
+    hiZBinding.setBinding(1);
+    hiZBinding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    hiZBinding.setDescriptorCount(1);
+    hiZBinding.setStageFlags(vk::ShaderStageFlags(vk::ShaderStageFlagBits::eCompute));
+    hiZBinding.setPImmutableSamplers(nullptr);
+
+    std::array<vk::DescriptorSetLayoutBinding, 2> occlusionBindings = { occlusionUboBinding, hiZBinding };
+    vk::DescriptorSetLayoutCreateInfo occlusionLayoutInfo;
+    occlusionLayoutInfo.setBindingCount(static_cast<uint32_t>(occlusionBindings.size()));
+    occlusionLayoutInfo.setPBindings(occlusionBindings.data());
+
+    try {
+        occlusionDescriptorSetLayout = logicalDevice.createDescriptorSetLayout(occlusionLayoutInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create occlusion descriptor set layout");
+    }
+}
+
+void Renderer::CreateOcclusionResources() {
+    // The pyramid is only ever read with texelFetch, so filtering doesn't matter
+    vk::SamplerCreateInfo samplerInfo;
+    samplerInfo.setMagFilter(vk::Filter::eNearest);
+    samplerInfo.setMinFilter(vk::Filter::eNearest);
+    samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+    samplerInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+    samplerInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+    samplerInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+    samplerInfo.setAnisotropyEnable(VK_FALSE);
+    samplerInfo.setMaxAnisotropy(1.0f);
+    samplerInfo.setMinLod(0.0f);
+    samplerInfo.setMaxLod(VK_LOD_CLAMP_NONE);
+    samplerInfo.setUnnormalizedCoordinates(VK_FALSE);
+
+    try {
+        hiZSampler = logicalDevice.createSampler(samplerInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create Hi-Z sampler");
+    }
+
+    BufferUtils::CreateBuffer(device, sizeof(OcclusionBufferObject), vk::BufferUsageFlags(vk::BufferUsageFlagBits::eUniformBuffer), vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent), occlusionBuffer, occlusionBufferMemory);
+    occlusionMappedData = logicalDevice.mapMemory(occlusionBufferMemory, 0, sizeof(OcclusionBufferObject));
+
+    occlusionBufferObject = {};
+    memcpy(occlusionMappedData, &occlusionBufferObject, sizeof(OcclusionBufferObject));
+
+    // Signaled up front, so the first frame doesn't wait for a submission that never happened
+    try {
+        computeFence = logicalDevice.createFence(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create compute fence");
+    }
+}
+
 void Renderer::CreateDescriptorPool() {
     // Describe which descriptor types that the descriptor sets will contain
     std::vector<vk::DescriptorPoolSize> poolSizes = {
@@ -261,9 +489,13 @@ void Renderer::CreateDescriptorPool() {
         // Time (compute)
         { vk::DescriptorType::eUniformBuffer, 1 },
 
+        // Terrain model buffer, texture and height and normal map
+        { vk::DescriptorType::eUniformBuffer, 1 },
+        { vk::DescriptorType::eCombinedImageSampler, 2 },
+
         // TODO: Add any additional types and counts of descriptors you will need to allocate
-        // Blades, culledBlades, numBlades aftering compute shader
-        { vk::DescriptorType::eStorageBuffer, static_cast<uint32_t>(3 * scene->GetBlades().size()) }
+        // Blades, bladeStates, culledBlades, numBlades aftering compute shader, plus tiles, visibleTiles and dispatchIndirect for tile culling
+        { vk::DescriptorType::eStorageBuffer, static_cast<uint32_t>(7 * scene->GetBlades().size()) }
     };
 
     vk::DescriptorPoolCreateInfo poolInfo;
@@ -369,6 +601,66 @@ void Renderer::CreateModelDescriptorSets() {
     logicalDevice.updateDescriptorSets(static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
+void Renderer::CreateTerrainDescriptorSet() {
+    Terrain* terrain = scene->GetTerrain();
+    if (!terrain) {
+        return;
+    }
+
+    std::array<vk::DescriptorSetLayout, 1> layouts = { terrainDescriptorSetLayout };
+
+    vk::DescriptorSetAllocateInfo allocInfo;
+    allocInfo.setDescriptorPool(descriptorPool);
+    allocInfo.setDescriptorSetCount(1);
+    allocInfo.setPSetLayouts(layouts.data());
+
+    try {
+        logicalDevice.allocateDescriptorSets(&allocInfo, &terrainDescriptorSet);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to allocate terrain descriptor set");
+    }
+
+    vk::DescriptorBufferInfo modelBufferInfo;
+    modelBufferInfo.setBuffer(terrain->GetModelBuffer());
+    modelBufferInfo.setOffset(0);
+    modelBufferInfo.setRange(sizeof(ModelBufferObject));
+
+    vk::DescriptorImageInfo imageInfo;
+    imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    imageInfo.setImageView(terrain->GetTextureView());
+    imageInfo.setSampler(terrain->GetTextureSampler());
+
+    vk::DescriptorImageInfo mapInfo;
+    mapInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    mapInfo.setImageView(terrain->GetMapView());
+    mapInfo.setSampler(terrain->GetMapSampler());
+
+    std::array<vk::WriteDescriptorSet, 3> descriptorWrites;
+    descriptorWrites[0].setDstSet(terrainDescriptorSet);
+    descriptorWrites[0].setDstBinding(0);
+    descriptorWrites[0].setDstArrayElement(0);
+    descriptorWrites[0].setDescriptorType(vk::DescriptorType::eUniformBuffer);
+    descriptorWrites[0].setDescriptorCount(1);
+    descriptorWrites[0].setPBufferInfo(&modelBufferInfo);
+
+    descriptorWrites[1].setDstSet(terrainDescriptorSet);
+    descriptorWrites[1].setDstBinding(1);
+    descriptorWrites[1].setDstArrayElement(0);
+    descriptorWrites[1].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    descriptorWrites[1].setDescriptorCount(1);
+    descriptorWrites[1].setPImageInfo(&imageInfo);
+
+    descriptorWrites[2].setDstSet(terrainDescriptorSet);
+    descriptorWrites[2].setDstBinding(2);
+    descriptorWrites[2].setDstArrayElement(0);
+    descriptorWrites[2].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    descriptorWrites[2].setDescriptorCount(1);
+    descriptorWrites[2].setPImageInfo(&mapInfo);
+
+    logicalDevice.updateDescriptorSets(static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
 void Renderer::CreateGrassDescriptorSets() {
     grassDescriptorSets.resize(scene->GetBlades().size());
     // Create Descriptor sets for the grass.
@@ -462,13 +754,12 @@ void Renderer::CreateComputeDescriptorSets() {
         throw std::runtime_error("Failed to allocate compute descriptor set");
     }
 
-    std::vector<vk::WriteDescriptorSet> computeDescriptorWrites;
     for (int i = 0; i < scene->GetBlades().size(); i++) {
         // Bind and write blades buffer to its descriptor
         vk::DescriptorBufferInfo bladesBufferInfo;
         bladesBufferInfo.setBuffer(scene->GetBlades()[i]->GetBladesBuffer());
         bladesBufferInfo.setOffset(0);
-        bladesBufferInfo.setRange(static_cast<uint32_t>(NUM_BLADES * sizeof(Blade)));
+        bladesBufferInfo.setRange(static_cast<uint32_t>(scene->GetBlades()[i]->GetBladeCount() * sizeof(Blade)));
 
         vk::WriteDescriptorSet bladesDescriptorWrite;
         bladesDescriptorWrite.setDstSet(computeDescriptorSets[i]);
@@ -484,7 +775,7 @@ void Renderer::CreateComputeDescriptorSets() {
         vk::DescriptorBufferInfo culledBladesBufferInfo;
         culledBladesBufferInfo.setBuffer(scene->GetBlades()[i]->GetCulledBladesBuffer());
         culledBladesBufferInfo.setOffset(0);
-        culledBladesBufferInfo.setRange(static_cast<uint32_t>(NUM_BLADES * sizeof(Blade)));
+        culledBladesBufferInfo.setRange(static_cast<uint32_t>(BLADE_LOD_COUNT * scene->GetBlades()[i]->GetBladeCount() * sizeof(CulledBlade)));
 
         vk::WriteDescriptorSet culledBladesDescriptorWrite;
         culledBladesDescriptorWrite.setDstSet(computeDescriptorSets[i]);
@@ -500,7 +791,7 @@ void Renderer::CreateComputeDescriptorSets() {
         vk::DescriptorBufferInfo numBladesBufferInfo;
         numBladesBufferInfo.setBuffer(scene->GetBlades()[i]->GetNumBladesBuffer());
         numBladesBufferInfo.setOffset(0);
-        numBladesBufferInfo.setRange(static_cast<uint32_t>(sizeof(BladeDrawIndirect)));
+        numBladesBufferInfo.setRange(static_cast<uint32_t>(BLADE_DRAW_COUNT * sizeof(BladeDrawIndirect)));
 
         vk::WriteDescriptorSet numBladesDescriptorWrite;
         numBladesDescriptorWrite.setDstSet(computeDescriptorSets[i]);
@@ -512,17 +803,117 @@ void Renderer::CreateComputeDescriptorSets() {
         numBladesDescriptorWrite.setPImageInfo(nullptr);
         numBladesDescriptorWrite.setPTexelBufferView(nullptr);
 
-        computeDescriptorWrites.push_back(bladesDescriptorWrite);
-        computeDescriptorWrites.push_back(culledBladesDescriptorWrite);
-        computeDescriptorWrites.push_back(numBladesDescriptorWrite);
+        // Bind and write the tile buffers to their descriptors
+        vk::DescriptorBufferInfo tilesBufferInfo;
+        tilesBufferInfo.setBuffer(scene->GetBlades()[i]->GetTilesBuffer());
+        tilesBufferInfo.setOffset(0);
+        tilesBufferInfo.setRange(static_cast<uint32_t>(scene->GetBlades()[i]->GetTileCount() * sizeof(BladeTile)));
+
+        vk::WriteDescriptorSet tilesDescriptorWrite;
+        tilesDescriptorWrite.setDstSet(computeDescriptorSets[i]);
+        tilesDescriptorWrite.setDstBinding(3);
+        tilesDescriptorWrite.setDstArrayElement(0);
+        tilesDescriptorWrite.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+        tilesDescriptorWrite.setDescriptorCount(1);
+        tilesDescriptorWrite.setPBufferInfo(&tilesBufferInfo);
+        tilesDescriptorWrite.setPImageInfo(nullptr);
+        tilesDescriptorWrite.setPTexelBufferView(nullptr);
+
+        vk::DescriptorBufferInfo visibleTilesBufferInfo;
+        visibleTilesBufferInfo.setBuffer(scene->GetBlades()[i]->GetVisibleTilesBuffer());
+        visibleTilesBufferInfo.setOffset(0);
+        visibleTilesBufferInfo.setRange(static_cast<uint32_t>(scene->GetBlades()[i]->GetTileCount() * sizeof(uint32_t)));
+
+        vk::WriteDescriptorSet visibleTilesDescriptorWrite;
+        visibleTilesDescriptorWrite.setDstSet(computeDescriptorSets[i]);
+        visibleTilesDescriptorWrite.setDstBinding(4);
+        visibleTilesDescriptorWrite.setDstArrayElement(0);
+        visibleTilesDescriptorWrite.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+        visibleTilesDescriptorWrite.setDescriptorCount(1);
+        visibleTilesDescriptorWrite.setPBufferInfo(&visibleTilesBufferInfo);
+        visibleTilesDescriptorWrite.setPImageInfo(nullptr);
+        visibleTilesDescriptorWrite.setPTexelBufferView(nullptr);
+
+        vk::DescriptorBufferInfo dispatchIndirectBufferInfo;
+        dispatchIndirectBufferInfo.setBuffer(scene->GetBlades()[i]->GetDispatchIndirectBuffer());
+        dispatchIndirectBufferInfo.setOffset(0);
+        dispatchIndirectBufferInfo.setRange(static_cast<uint32_t>(sizeof(BladeDispatchIndirect)));
+
+        vk::WriteDescriptorSet dispatchIndirectDescriptorWrite;
+        dispatchIndirectDescriptorWrite.setDstSet(computeDescriptorSets[i]);
+        dispatchIndirectDescriptorWrite.setDstBinding(5);
+        dispatchIndirectDescriptorWrite.setDstArrayElement(0);
+        dispatchIndirectDescriptorWrite.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+        dispatchIndirectDescriptorWrite.setDescriptorCount(1);
+        dispatchIndirectDescriptorWrite.setPBufferInfo(&dispatchIndirectBufferInfo);
+        dispatchIndirectDescriptorWrite.setPImageInfo(nullptr);
+        dispatchIndirectDescriptorWrite.setPTexelBufferView(nullptr);
+
+        vk::DescriptorBufferInfo bladeStatesBufferInfo;
+        bladeStatesBufferInfo.setBuffer(scene->GetBlades()[i]->GetBladeStatesBuffer());
+        bladeStatesBufferInfo.setOffset(0);
+        bladeStatesBufferInfo.setRange(static_cast<uint32_t>(scene->GetBlades()[i]->GetBladeCount() * sizeof(BladeState)));
+
+        vk::WriteDescriptorSet bladeStatesDescriptorWrite;
+        bladeStatesDescriptorWrite.setDstSet(computeDescriptorSets[i]);
+        bladeStatesDescriptorWrite.setDstBinding(6);
+        bladeStatesDescriptorWrite.setDstArrayElement(0);
+        bladeStatesDescriptorWrite.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+        bladeStatesDescriptorWrite.setDescriptorCount(1);
+        bladeStatesDescriptorWrite.setPBufferInfo(&bladeStatesBufferInfo);
+        bladeStatesDescriptorWrite.setPImageInfo(nullptr);
+        bladeStatesDescriptorWrite.setPTexelBufferView(nullptr);
+
+        // Update inside the loop, the buffer infos above only live for this iteration
+        std::array<vk::WriteDescriptorSet, 7> computeDescriptorWrites = {
+            bladesDescriptorWrite, culledBladesDescriptorWrite, numBladesDescriptorWrite,
+            tilesDescriptorWrite, visibleTilesDescriptorWrite, dispatchIndirectDescriptorWrite,
+            bladeStatesDescriptorWrite
+        };
+        logicalDevice.updateDescriptorSets(static_cast<uint32_t>(computeDescriptorWrites.size()), computeDescriptorWrites.data(), 0, nullptr);
     }
-
-    logicalDevice.updateDescriptorSets(static_cast<uint32_t>(computeDescriptorWrites.size()), computeDescriptorWrites.data(), 0, nullptr);
 }
 
 void Renderer::CreateGraphicsPipeline() {
-    vk::ShaderModule vertShaderModule = ShaderModule::Create("shaders/graphics.vert.spv", logicalDevice);
-    vk::ShaderModule fragShaderModule = ShaderModule::Create("shaders/graphics.frag.spv", logicalDevice);
+    std::vector<vk::DescriptorSetLayout> descriptorSetLayouts = { cameraDescriptorSetLayout, modelDescriptorSetLayout };
+
+    // Pipeline layout: used to specify uniform values
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+    pipelineLayoutInfo.setSetLayoutCount(static_cast<uint32_t>(descriptorSetLayouts.size()));
+    pipelineLayoutInfo.setPSetLayouts(descriptorSetLayouts.data());
+    pipelineLayoutInfo.setPushConstantRangeCount(0);
+    pipelineLayoutInfo.setPushConstantRanges(0);
+
+    try {
+        graphicsPipelineLayout = logicalDevice.createPipelineLayout(pipelineLayoutInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create pipeline layout");
+    }
+
+    // The terrain draws like a model, with the height and normal map next to its model buffer and texture
+    std::vector<vk::DescriptorSetLayout> terrainSetLayouts = { cameraDescriptorSetLayout, terrainDescriptorSetLayout };
+
+    vk::PipelineLayoutCreateInfo terrainLayoutInfo;
+    terrainLayoutInfo.setSetLayoutCount(static_cast<uint32_t>(terrainSetLayouts.size()));
+    terrainLayoutInfo.setPSetLayouts(terrainSetLayouts.data());
+    terrainLayoutInfo.setPushConstantRangeCount(0);
+    terrainLayoutInfo.setPushConstantRanges(0);
+
+    try {
+        terrainPipelineLayout = logicalDevice.createPipelineLayout(terrainLayoutInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create terrain pipeline layout");
+    }
+
+    graphicsPipeline = BuildGraphicsPipeline("shaders/graphics.vert.spv", "shaders/graphics.frag.spv", graphicsPipelineLayout);
+    terrainPipeline = BuildGraphicsPipeline("shaders/terrain.vert.spv", "shaders/terrain.frag.spv", terrainPipelineLayout);
+}
+
+vk::Pipeline Renderer::BuildGraphicsPipeline(const std::string& vertShaderPath, const std::string& fragShaderPath, vk::PipelineLayout layout) {
+    vk::ShaderModule vertShaderModule = ShaderModule::Create(vertShaderPath, logicalDevice);
+    vk::ShaderModule fragShaderModule = ShaderModule::Create(fragShaderPath, logicalDevice);
 
     // Assign each shader module to the appropriate stage in the pipeline
     vk::PipelineShaderStageCreateInfo vertShaderStageInfo;
@@ -630,22 +1021,6 @@ void Renderer::CreateGraphicsPipeline() {
     colorBlending.blendConstants[2] = 0.0f;
     colorBlending.blendConstants[3] = 0.0f;
 
-    std::vector<vk::DescriptorSetLayout> descriptorSetLayouts = { cameraDescriptorSetLayout, modelDescriptorSetLayout };
-
-    // Pipeline layout: used to specify uniform values
-    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
-    pipelineLayoutInfo.setSetLayoutCount(static_cast<uint32_t>(descriptorSetLayouts.size()));
-    pipelineLayoutInfo.setPSetLayouts(descriptorSetLayouts.data());
-    pipelineLayoutInfo.setPushConstantRangeCount(0);
-    pipelineLayoutInfo.setPushConstantRanges(0);
-
-    try {
-        graphicsPipelineLayout = logicalDevice.createPipelineLayout(pipelineLayoutInfo);
-    }
-    catch (vk::SystemError err) {
-        throw std::runtime_error("Failed to create pipeline layout");
-    }
-
     // --- Create graphics pipeline ---
     vk::GraphicsPipelineCreateInfo pipelineInfo;
     pipelineInfo.setStageCount(2);
@@ -658,14 +1033,15 @@ void Renderer::CreateGraphicsPipeline() {
     pipelineInfo.setPDepthStencilState(&depthStencil);
     pipelineInfo.setPColorBlendState(&colorBlending);
     pipelineInfo.setPDynamicState(nullptr);
-    pipelineInfo.setLayout(graphicsPipelineLayout);
+    pipelineInfo.setLayout(layout);
     pipelineInfo.setRenderPass(renderPass);
     pipelineInfo.setSubpass(0);
     pipelineInfo.setBasePipelineHandle(nullptr);
     pipelineInfo.setBasePipelineIndex(1);
 
+    vk::Pipeline pipeline;
     try {
-        graphicsPipeline = (vk::Pipeline)logicalDevice.createGraphicsPipeline(nullptr, pipelineInfo);
+        pipeline = (vk::Pipeline)logicalDevice.createGraphicsPipeline(nullptr, pipelineInfo);
     }
     catch (vk::SystemError err) {
         throw std::runtime_error("Failed to create graphics pipeline");
@@ -673,9 +1049,36 @@ void Renderer::CreateGraphicsPipeline() {
 
     logicalDevice.destroyShaderModule(vertShaderModule);
     logicalDevice.destroyShaderModule(fragShaderModule);
+
+    return pipeline;
 }
 
 void Renderer::CreateGrassPipeline() {
+    std::vector<vk::DescriptorSetLayout> descriptorSetLayouts = { cameraDescriptorSetLayout, modelDescriptorSetLayout };
+
+    // Pipeline layout: used to specify uniform values
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+    pipelineLayoutInfo.setSetLayoutCount(static_cast<uint32_t>(descriptorSetLayouts.size()));
+    pipelineLayoutInfo.setPSetLayouts(descriptorSetLayouts.data());
+    pipelineLayoutInfo.setPushConstantRangeCount(0);
+    pipelineLayoutInfo.setPPushConstantRanges(0);
+    
+    try {
+        grassPipelineLayout = logicalDevice.createPipelineLayout(pipelineLayoutInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create grass pipeline layout");
+    }
+
+    if (tessellationSupported) {
+        grassPipeline = BuildGrassPipeline();
+    }
+    grassNearStripPipeline = BuildGrassStripPipeline("shaders/grass_strip.vert.spv", "shaders/grass.frag.spv", NEAR_STRIP_SEGMENTS);
+    grassLowPolyPipeline = BuildGrassStripPipeline("shaders/grass_strip.vert.spv", "shaders/grass.frag.spv", LOW_POLY_SEGMENTS);
+    grassImpostorPipeline = BuildGrassStripPipeline("shaders/grass_impostor.vert.spv", "shaders/grass_impostor.frag.spv");
+}
+
+vk::Pipeline Renderer::BuildGrassPipeline() {
     // --- Set up programmable shaders ---
     vk::ShaderModule vertShaderModule = ShaderModule::Create("shaders/grass.vert.spv", logicalDevice);
     vk::ShaderModule tescShaderModule = ShaderModule::Create("shaders/grass.tesc.spv", logicalDevice);
@@ -709,8 +1112,8 @@ void Renderer::CreateGrassPipeline() {
     // Vertex input
     vk::PipelineVertexInputStateCreateInfo vertexInputInfo;
    
-    auto bindingDescription = Blade::getBindingDescription();
-    auto attributeDescriptions = Blade::getAttributeDescriptions();
+    auto bindingDescription = CulledBlade::getBindingDescription();
+    auto attributeDescriptions = CulledBlade::getAttributeDescriptions();
 
     vertexInputInfo.setVertexBindingDescriptionCount(1);
     vertexInputInfo.setPVertexBindingDescriptions(&bindingDescription);
@@ -798,22 +1201,6 @@ void Renderer::CreateGrassPipeline() {
     colorBlending.blendConstants[2] = 0.0f;
     colorBlending.blendConstants[3] = 0.0f;
 
-    std::vector<vk::DescriptorSetLayout> descriptorSetLayouts = { cameraDescriptorSetLayout, modelDescriptorSetLayout };
-
-    // Pipeline layout: used to specify uniform values
-    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
-    pipelineLayoutInfo.setSetLayoutCount(static_cast<uint32_t>(descriptorSetLayouts.size()));
-    pipelineLayoutInfo.setPSetLayouts(descriptorSetLayouts.data());
-    pipelineLayoutInfo.setPushConstantRangeCount(0);
-    pipelineLayoutInfo.setPPushConstantRanges(0);
-    
-    try {
-        grassPipelineLayout = logicalDevice.createPipelineLayout(pipelineLayoutInfo);
-    }
-    catch (vk::SystemError err) {
-        throw std::runtime_error("Failed to create grass pipeline layout");
-    }
-
     // Tessellation state
     vk::PipelineTessellationStateCreateInfo tessellationInfo;
     tessellationInfo.setPNext(nullptr);
@@ -839,8 +1226,9 @@ void Renderer::CreateGrassPipeline() {
     pipelineInfo.setBasePipelineHandle(nullptr);
     pipelineInfo.setBasePipelineIndex(-1);
 
+    vk::Pipeline pipeline;
     try {
-        grassPipeline = (vk::Pipeline)logicalDevice.createGraphicsPipeline(nullptr, pipelineInfo);
+        pipeline = (vk::Pipeline)logicalDevice.createGraphicsPipeline(nullptr, pipelineInfo);
     }
     catch (vk::SystemError err) {
         throw std::runtime_error("Failed to create graphics pipeline");
@@ -851,68 +1239,517 @@ void Renderer::CreateGrassPipeline() {
     logicalDevice.destroyShaderModule(tescShaderModule);
     logicalDevice.destroyShaderModule(teseShaderModule);
     logicalDevice.destroyShaderModule(fragShaderModule);
+
+    return pipeline;
 }
 
-void Renderer::CreateComputePipeline() {
-    // Set up programmable shaders
-    vk::ShaderModule computeShaderModule = ShaderModule::Create("shaders/compute.comp.spv", logicalDevice);
+vk::Pipeline Renderer::BuildGrassStripPipeline(const std::string& vertShaderPath, const std::string& fragShaderPath, uint32_t segments) {
+    // --- Set up programmable shaders ---
+    vk::ShaderModule vertShaderModule = ShaderModule::Create(vertShaderPath, logicalDevice);
+    vk::ShaderModule fragShaderModule = ShaderModule::Create(fragShaderPath, logicalDevice);
 
-    vk::PipelineShaderStageCreateInfo computeShaderStageInfo;
-    computeShaderStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
-    computeShaderStageInfo.setModule(computeShaderModule);
-    computeShaderStageInfo.setPName("main");
-   
-    // Add the compute descriptor set layout you create to this list
-    std::array<vk::DescriptorSetLayout, 3> descriptorSetLayouts = { cameraDescriptorSetLayout, timeDescriptorSetLayout, computeDescriptorSetLayout };
+    // Number of strip segments, used by grass_strip.vert
+    vk::SpecializationMapEntry specializationEntry(0, 0, sizeof(uint32_t));
 
-    // Create pipeline layout
-    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
-    pipelineLayoutInfo.setSetLayoutCount(static_cast<uint32_t>(descriptorSetLayouts.size()));
-    pipelineLayoutInfo.setPSetLayouts(descriptorSetLayouts.data());
-    pipelineLayoutInfo.setPushConstantRangeCount(0);
-    pipelineLayoutInfo.setPushConstantRanges(0);
-    
-    try {
-        computePipelineLayout = logicalDevice.createPipelineLayout(pipelineLayoutInfo);
-    }
-    catch (vk::SystemError err) {
-        throw std::runtime_error("Failed to create compute pipeline layout");
-    }
+    vk::SpecializationInfo specializationInfo;
+    specializationInfo.setMapEntryCount(1);
+    specializationInfo.setPMapEntries(&specializationEntry);
+    specializationInfo.setDataSize(sizeof(uint32_t));
+    specializationInfo.setPData(&segments);
 
-    // Create compute pipeline
-    vk::ComputePipelineCreateInfo pipelineInfo;
-    pipelineInfo.setStage(computeShaderStageInfo);
-    pipelineInfo.setLayout(computePipelineLayout);
-    pipelineInfo.setPNext(nullptr);
-    // pipelineInfo.setFlags(vk::PipelineCreateFlags(0));
-    pipelineInfo.setBasePipelineHandle(nullptr);
-    pipelineInfo.setBasePipelineIndex(-1);
+    // Assign each shader module to the appropriate stage in the pipeline
+    vk::PipelineShaderStageCreateInfo vertShaderStageInfo;
+    vertShaderStageInfo.setStage(vk::ShaderStageFlagBits::eVertex);
+    vertShaderStageInfo.setModule(vertShaderModule);
+    vertShaderStageInfo.setPName("main");
+    vertShaderStageInfo.setPSpecializationInfo(&specializationInfo);
+
+    vk::PipelineShaderStageCreateInfo fragShaderStageInfo;
+    fragShaderStageInfo.setStage(vk::ShaderStageFlagBits::eFragment);
+    fragShaderStageInfo.setModule(fragShaderModule);
+    fragShaderStageInfo.setPName("main");
     
-    try {
-        computePipeline = (vk::Pipeline)logicalDevice.createComputePipeline(nullptr, pipelineInfo);
-    }
-    catch (vk::SystemError err) {
-        throw std::runtime_error("Failed to create compute pipeline");
-    }
+    std::array<vk::PipelineShaderStageCreateInfo, 2> shaderStages = { vertShaderStageInfo, fragShaderStageInfo };
 
-    // No need for shader modules anymore
-    vkDestroyShaderModule(logicalDevice, computeShaderModule, nullptr);
-}
+    // --- Set up fixed-function stages ---
+    // Vertex input
+    vk::PipelineVertexInputStateCreateInfo vertexInputInfo;
+   
+    auto bindingDescription = CulledBlade::getBindingDescription();
+    auto attributeDescriptions = CulledBlade::getAttributeDescriptions();
 
-void Renderer::CreateFrameResources() {
-    imageViews.resize(swapChain->GetCount());
+    vertexInputInfo.setVertexBindingDescriptionCount(1);
+    vertexInputInfo.setPVertexBindingDescriptions(&bindingDescription);
+    vertexInputInfo.setVertexAttributeDescriptionCount(static_cast<uint32_t>(attributeDescriptions.size()));
+    vertexInputInfo.setPVertexAttributeDescriptions(attributeDescriptions.data());
+   
+    // Input Assembly
+    vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
+    // Each instance is its own strip, so no restart index is needed between blades
+    inputAssembly.setTopology(vk::PrimitiveTopology::eTriangleStrip);
+    inputAssembly.setPrimitiveRestartEnable(VK_FALSE);
+   
+    // Viewports and Scissors (rectangles that define in which regions pixels are stored)
+    vk::Viewport viewport;
+    viewport.setX(0.0f);
+    viewport.setY(0.0f);
+    viewport.setWidth(static_cast<float>(swapChain->GetVkExtent().width));
+    viewport.setHeight(static_cast<float>(swapChain->GetVkExtent().height));
+    viewport.setMinDepth(0.0f);
+    viewport.setMaxDepth(1.0f);
 
-    for (uint32_t i = 0; i < swapChain->GetCount(); i++) {
-        // --- Create an image view for each swap chain image ---
-        vk::ImageViewCreateInfo createInfo;
-        createInfo.setImage(swapChain->GetVkImage(i));
-      
-        // Specify how the image data should be interpreted
-        createInfo.setViewType(vk::ImageViewType::e2D);
-        createInfo.setFormat(swapChain->GetVkImageFormat());
+    vk::Rect2D scissor = {};
+    scissor.setOffset({ 0, 0 });
+    scissor.setExtent(swapChain->GetVkExtent());
 
-        // Specify color channel mappings (can be used for swizzling)
-        createInfo.components.r = vk::ComponentSwizzle::eIdentity;
+    vk::PipelineViewportStateCreateInfo viewportState;
+    viewportState.setViewportCount(1);
+    viewportState.setPViewports(&viewport);
+    viewportState.setScissorCount(1);
+    viewportState.setPScissors(&scissor);
+   
+    // Rasterizer
+    vk::PipelineRasterizationStateCreateInfo rasterizer;
+    rasterizer.setDepthClampEnable(VK_FALSE);
+    rasterizer.setRasterizerDiscardEnable(VK_FALSE);
+    rasterizer.setPolygonMode(vk::PolygonMode::eFill);
+    rasterizer.setLineWidth(1.0f);
+    rasterizer.setCullMode(vk::CullModeFlags(vk::CullModeFlagBits::eNone));
+    rasterizer.setFrontFace(vk::FrontFace::eCounterClockwise);
+    rasterizer.setDepthBiasEnable(VK_FALSE);
+    rasterizer.setDepthBiasConstantFactor(0.0f);
+    rasterizer.setDepthBiasClamp(0.0f);
+    rasterizer.setDepthBiasSlopeFactor(0.0f);
+    
+    // Multisampling (turned off here)
+    vk::PipelineMultisampleStateCreateInfo multisampling;
+    multisampling.setSampleShadingEnable(VK_FALSE);
+    multisampling.setRasterizationSamples(vk::SampleCountFlagBits::e1);
+    multisampling.setMinSampleShading(1.0f);
+    multisampling.setPSampleMask(nullptr);
+    multisampling.setAlphaToCoverageEnable(VK_FALSE);
+    multisampling.setAlphaToOneEnable(VK_FALSE);
+    
+    // Depth testing
+    vk::PipelineDepthStencilStateCreateInfo depthStencil;
+    depthStencil.setDepthTestEnable(VK_TRUE);
+    depthStencil.setDepthWriteEnable(VK_TRUE);
+    depthStencil.setDepthCompareOp(vk::CompareOp::eLess);
+    depthStencil.setDepthBoundsTestEnable(VK_FALSE);
+    depthStencil.setMinDepthBounds(0.0f);
+    depthStencil.setMaxDepthBounds(1.0f);
+    depthStencil.setStencilTestEnable(VK_FALSE);
+    
+    // Color blending (turned off here, but showing options for learning)
+    // --> Configuration per attached framebuffer
+    vk::PipelineColorBlendAttachmentState colorBlendAttachment;
+    colorBlendAttachment.setColorWriteMask(vk::ColorComponentFlags(vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+                                                                   vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA));
+    colorBlendAttachment.setBlendEnable(VK_FALSE);
+    colorBlendAttachment.setSrcColorBlendFactor(vk::BlendFactor::eOne);
+    colorBlendAttachment.setDstColorBlendFactor(vk::BlendFactor::eZero);
+    colorBlendAttachment.setColorBlendOp(vk::BlendOp::eAdd);
+    colorBlendAttachment.setSrcAlphaBlendFactor(vk::BlendFactor::eOne);
+    colorBlendAttachment.setDstAlphaBlendFactor(vk::BlendFactor::eZero);
+    colorBlendAttachment.setAlphaBlendOp(vk::BlendOp::eAdd);
+    
+    // --> Global color blending settings
+    vk::PipelineColorBlendStateCreateInfo colorBlending;
+    colorBlending.setLogicOpEnable(VK_FALSE);
+    colorBlending.setLogicOp(vk::LogicOp::eCopy);
+    colorBlending.setAttachmentCount(1);
+    colorBlending.setPAttachments(&colorBlendAttachment);
+    colorBlending.blendConstants[0] = 0.0f;
+    colorBlending.blendConstants[1] = 0.0f;
+    colorBlending.blendConstants[2] = 0.0f;
+    colorBlending.blendConstants[3] = 0.0f;
+
+    // --- Create graphics pipeline ---
+    vk::GraphicsPipelineCreateInfo pipelineInfo;
+    pipelineInfo.setStageCount(static_cast<uint32_t>(shaderStages.size()));
+    pipelineInfo.setPStages(shaderStages.data());
+    pipelineInfo.setPVertexInputState(&vertexInputInfo);
+    pipelineInfo.setPInputAssemblyState(&inputAssembly);
+    pipelineInfo.setPViewportState(&viewportState);
+    pipelineInfo.setPRasterizationState(&rasterizer);
+    pipelineInfo.setPMultisampleState(&multisampling);
+    pipelineInfo.setPDepthStencilState(&depthStencil);
+    pipelineInfo.setPColorBlendState(&colorBlending);
+    pipelineInfo.setPDynamicState(nullptr);
+    pipelineInfo.setLayout(grassPipelineLayout);
+    pipelineInfo.setRenderPass(renderPass);
+    pipelineInfo.setSubpass(0);
+    pipelineInfo.setBasePipelineHandle(nullptr);
+    pipelineInfo.setBasePipelineIndex(-1);
+
+    vk::Pipeline pipeline;
+    try {
+        pipeline = (vk::Pipeline)logicalDevice.createGraphicsPipeline(nullptr, pipelineInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create graphics pipeline");
+    }
+
+    // No need for the shader modules anymore
+    logicalDevice.destroyShaderModule(vertShaderModule);
+    logicalDevice.destroyShaderModule(fragShaderModule);
+
+    return pipeline;
+}
+
+void Renderer::CreateComputePipeline() {
+    // Add the compute descriptor set layout you create to this list
+    std::array<vk::DescriptorSetLayout, 4> descriptorSetLayouts = { cameraDescriptorSetLayout, timeDescriptorSetLayout, computeDescriptorSetLayout, occlusionDescriptorSetLayout };
+
+    // Create pipeline layout
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+    pipelineLayoutInfo.setSetLayoutCount(static_cast<uint32_t>(descriptorSetLayouts.size()));
+    pipelineLayoutInfo.setPSetLayouts(descriptorSetLayouts.data());
+    pipelineLayoutInfo.setPushConstantRangeCount(0);
+    pipelineLayoutInfo.setPushConstantRanges(0);
+    
+    try {
+        computePipelineLayout = logicalDevice.createPipelineLayout(pipelineLayoutInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create compute pipeline layout");
+    }
+
+    // Tessellation levels are packed in 5 bits each so they stay exact in a half, see packTessLevels in compute.comp
+    float maxTessellationLevel = static_cast<float>(device->GetInstance()->GetPhysicalDevice().getProperties().limits.maxTessellationGenerationLevel);
+    computeConstants.maxTessLevel = std::min({ computeConstants.maxTessLevel, maxTessellationLevel, 31.0f });
+
+    tileCullPipeline = BuildTileCullPipeline(computeConstants);
+
+    TuneComputeWorkgroupSize();
+    computePipeline = BuildComputePipeline(computeConstants);
+}
+
+vk::Pipeline Renderer::BuildTileCullPipeline(const ComputeConstants& constants) {
+    vk::ShaderModule tilesShaderModule = ShaderModule::Create("shaders/tiles.comp.spv", logicalDevice);
+
+    // Tile culling shares the distance range with the per-blade test
+    vk::SpecializationMapEntry specializationEntry(1, offsetof(ComputeConstants, distMax), sizeof(float));
+
+    vk::SpecializationInfo specializationInfo;
+    specializationInfo.setMapEntryCount(1);
+    specializationInfo.setPMapEntries(&specializationEntry);
+    specializationInfo.setDataSize(sizeof(ComputeConstants));
+    specializationInfo.setPData(&constants);
+
+    vk::PipelineShaderStageCreateInfo tilesShaderStageInfo;
+    tilesShaderStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+    tilesShaderStageInfo.setModule(tilesShaderModule);
+    tilesShaderStageInfo.setPName("main");
+    tilesShaderStageInfo.setPSpecializationInfo(&specializationInfo);
+
+    vk::ComputePipelineCreateInfo pipelineInfo;
+    pipelineInfo.setStage(tilesShaderStageInfo);
+    pipelineInfo.setLayout(computePipelineLayout);
+    pipelineInfo.setBasePipelineHandle(nullptr);
+    pipelineInfo.setBasePipelineIndex(-1);
+
+    vk::Pipeline pipeline;
+    try {
+        pipeline = (vk::Pipeline)logicalDevice.createComputePipeline(nullptr, pipelineInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create tile cull pipeline");
+    }
+
+    logicalDevice.destroyShaderModule(tilesShaderModule);
+
+    return pipeline;
+}
+
+vk::Pipeline Renderer::BuildComputePipeline(const ComputeConstants& constants) {
+    // Set up programmable shaders
+    vk::ShaderModule computeShaderModule = ShaderModule::Create("shaders/compute.comp.spv", logicalDevice);
+
+    // Map each tunable to its constant_id in compute.comp
+    std::array<vk::SpecializationMapEntry, 14> specializationEntries = {
+        vk::SpecializationMapEntry(0, offsetof(ComputeConstants, workgroupSize), sizeof(uint32_t)),
+        vk::SpecializationMapEntry(1, offsetof(ComputeConstants, distMax), sizeof(float)),
+        vk::SpecializationMapEntry(2, offsetof(ComputeConstants, densityFalloffStart), sizeof(float)),
+        vk::SpecializationMapEntry(3, offsetof(ComputeConstants, orientationThreshold), sizeof(float)),
+        vk::SpecializationMapEntry(4, offsetof(ComputeConstants, frustumTolerance), sizeof(float)),
+        vk::SpecializationMapEntry(5, offsetof(ComputeConstants, maxWidthScale), sizeof(float)),
+        vk::SpecializationMapEntry(6, offsetof(ComputeConstants, lowPolyDist), sizeof(float)),
+        vk::SpecializationMapEntry(7, offsetof(ComputeConstants, impostorDist), sizeof(float)),
+        vk::SpecializationMapEntry(8, offsetof(ComputeConstants, pixelsPerSegment), sizeof(float)),
+        vk::SpecializationMapEntry(9, offsetof(ComputeConstants, maxTessLevel), sizeof(float)),
+        vk::SpecializationMapEntry(10, offsetof(ComputeConstants, frustumSpheres), sizeof(vk::Bool32)),
+        vk::SpecializationMapEntry(11, offsetof(ComputeConstants, depthBinning), sizeof(vk::Bool32)),
+        vk::SpecializationMapEntry(12, offsetof(ComputeConstants, restSpeed), sizeof(float)),
+        vk::SpecializationMapEntry(13, offsetof(ComputeConstants, windWakeAngle), sizeof(float)),
+    };
+
+    vk::SpecializationInfo specializationInfo;
+    specializationInfo.setMapEntryCount(static_cast<uint32_t>(specializationEntries.size()));
+    specializationInfo.setPMapEntries(specializationEntries.data());
+    specializationInfo.setDataSize(sizeof(ComputeConstants));
+    specializationInfo.setPData(&constants);
+
+    vk::PipelineShaderStageCreateInfo computeShaderStageInfo;
+    computeShaderStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+    computeShaderStageInfo.setModule(computeShaderModule);
+    computeShaderStageInfo.setPName("main");
+    computeShaderStageInfo.setPSpecializationInfo(&specializationInfo);
+
+    // Create compute pipeline
+    vk::ComputePipelineCreateInfo pipelineInfo;
+    pipelineInfo.setStage(computeShaderStageInfo);
+    pipelineInfo.setLayout(computePipelineLayout);
+    pipelineInfo.setPNext(nullptr);
+    // pipelineInfo.setFlags(vk::PipelineCreateFlags(0));
+    pipelineInfo.setBasePipelineHandle(nullptr);
+    pipelineInfo.setBasePipelineIndex(-1);
+    
+    vk::Pipeline pipeline;
+    try {
+        pipeline = (vk::Pipeline)logicalDevice.createComputePipeline(nullptr, pipelineInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create compute pipeline");
+    }
+
+    // No need for shader modules anymore
+    vkDestroyShaderModule(logicalDevice, computeShaderModule, nullptr);
+
+    return pipeline;
+}
+
+void Renderer::CreateHiZPipeline() {
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+    pipelineLayoutInfo.setSetLayoutCount(1);
+    pipelineLayoutInfo.setPSetLayouts(&hiZDescriptorSetLayout);
+    pipelineLayoutInfo.setPushConstantRangeCount(0);
+    pipelineLayoutInfo.setPushConstantRanges(0);
+
+    try {
+        hiZPipelineLayout = logicalDevice.createPipelineLayout(pipelineLayoutInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create Hi-Z pipeline layout");
+    }
+
+    hiZPipeline = BuildHiZPipeline();
+}
+
+vk::Pipeline Renderer::BuildHiZPipeline() {
+    vk::ShaderModule hiZShaderModule = ShaderModule::Create("shaders/hiz.comp.spv", logicalDevice);
+
+    vk::PipelineShaderStageCreateInfo hiZShaderStageInfo;
+    hiZShaderStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+    hiZShaderStageInfo.setModule(hiZShaderModule);
+    hiZShaderStageInfo.setPName("main");
+
+    vk::ComputePipelineCreateInfo pipelineInfo;
+    pipelineInfo.setStage(hiZShaderStageInfo);
+    pipelineInfo.setLayout(hiZPipelineLayout);
+    pipelineInfo.setBasePipelineHandle(nullptr);
+    pipelineInfo.setBasePipelineIndex(-1);
+
+    vk::Pipeline pipeline;
+    try {
+        pipeline = (vk::Pipeline)logicalDevice.createComputePipeline(nullptr, pipelineInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create Hi-Z pipeline");
+    }
+
+    logicalDevice.destroyShaderModule(hiZShaderModule);
+
+    return pipeline;
+}
+
+void Renderer::TuneComputeWorkgroupSize() {
+    vk::PhysicalDevice physicalDevice = device->GetInstance()->GetPhysicalDevice();
+    vk::PhysicalDeviceLimits limits = physicalDevice.getProperties().limits;
+    uint32_t timestampValidBits = physicalDevice.getQueueFamilyProperties()[device->GetQueueIndex(QueueFlags::Compute)].timestampValidBits;
+
+    // Without timestamps there is nothing to measure, so keep the default size
+    if (timestampValidBits == 0) {
+        return;
+    }
+    uint64_t timestampMask = timestampValidBits >= 64 ? ~0ull : ((1ull << timestampValidBits) - 1);
+
+    vk::QueryPoolCreateInfo queryPoolInfo;
+    queryPoolInfo.setQueryType(vk::QueryType::eTimestamp);
+    queryPoolInfo.setQueryCount(2);
+
+    vk::QueryPool queryPool;
+    try {
+        queryPool = logicalDevice.createQueryPool(queryPoolInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create tuning query pool");
+    }
+
+    // Every benchmark run integrates the real blade states, so save them and put them back once tuning is done.
+    // Otherwise the field would start out dozens of frames in, depending on how many candidates the device allows.
+    std::vector<vk::Buffer> savedStatesBuffers;
+    std::vector<vk::DeviceMemory> savedStatesBufferMemories;
+    for (Blades* blades : scene->GetBlades()) {
+        vk::DeviceSize statesSize = blades->GetBladeCount() * sizeof(BladeState);
+        vk::Buffer savedStatesBuffer;
+        vk::DeviceMemory savedStatesBufferMemory;
+        BufferUtils::CreateBuffer(device, statesSize, vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal, savedStatesBuffer, savedStatesBufferMemory);
+        BufferUtils::CopyBuffer(device, graphicsCommandPool, blades->GetBladeStatesBuffer(), savedStatesBuffer, statesSize);
+        savedStatesBuffers.push_back(savedStatesBuffer);
+        savedStatesBufferMemories.push_back(savedStatesBufferMemory);
+    }
+
+    auto restoreStates = [&]() {
+        for (size_t i = 0; i < savedStatesBuffers.size(); i++) {
+            Blades* blades = scene->GetBlades()[i];
+            BufferUtils::CopyBuffer(device, graphicsCommandPool, savedStatesBuffers[i], blades->GetBladeStatesBuffer(), blades->GetBladeCount() * sizeof(BladeState));
+        }
+    };
+
+    double bestTime = std::numeric_limits<double>::max();
+    ComputeConstants candidateConstants = computeConstants;
+
+    for (uint32_t workgroupSize : WORKGROUP_SIZE_CANDIDATES) {
+        if (workgroupSize > limits.maxComputeWorkGroupSize[0] || workgroupSize > limits.maxComputeWorkGroupInvocations) {
+            continue;
+        }
+
+        candidateConstants.workgroupSize = workgroupSize;
+        double time = BenchmarkComputePipeline(candidateConstants, queryPool, timestampMask);
+        if (time < bestTime) {
+            bestTime = time;
+            computeConstants.workgroupSize = workgroupSize;
+        }
+    }
+
+    // Build with BLADE_MORTON_ORDER on and off to compare how the blade layout affects the pass
+    printf("Compute workgroup size: %u (%.4f ms per frame, blades in %s order)\n", computeConstants.workgroupSize, bestTime,
+        ENABLE_BLADE_MORTON_ORDER ? "Z" : "placement");
+
+    // Compare the frustum tests at the chosen size, both from the same blade states so their draw counts line up.
+    // Blades dropped by the other tests count as culled for both, so the difference in kept blades is the frustum test's.
+    uint32_t liveBlades = CountLiveBlades();
+    candidateConstants = computeConstants;
+
+    candidateConstants.frustumSpheres = VK_TRUE;
+    restoreStates();
+    double sphereTime = BenchmarkComputePipeline(candidateConstants, queryPool, timestampMask);
+    uint32_t sphereKept = CountKeptBlades();
+
+    candidateConstants.frustumSpheres = VK_FALSE;
+    restoreStates();
+    double pointTime = BenchmarkComputePipeline(candidateConstants, queryPool, timestampMask);
+    uint32_t pointKept = CountKeptBlades();
+
+    printf("Frustum test: bounding spheres %.4f ms, projected points %.4f ms per frame\n", sphereTime, pointTime);
+    printf("Frustum test: bounding spheres keep %u and cull %u, projected points keep %u and cull %u of %u blades\n",
+        sphereKept, liveBlades - sphereKept, pointKept, liveBlades - pointKept, liveBlades);
+
+    restoreStates();
+    for (size_t i = 0; i < savedStatesBuffers.size(); i++) {
+        logicalDevice.destroyBuffer(savedStatesBuffers[i]);
+        logicalDevice.freeMemory(savedStatesBufferMemories[i]);
+    }
+
+    logicalDevice.destroyQueryPool(queryPool);
+}
+
+double Renderer::BenchmarkComputePipeline(const ComputeConstants& constants, vk::QueryPool queryPool, uint64_t timestampMask) {
+    float timestampPeriod = device->GetInstance()->GetPhysicalDevice().getProperties().limits.timestampPeriod;
+
+    vk::CommandBufferAllocateInfo allocInfo;
+    allocInfo.setCommandPool(computeCommandPool);
+    allocInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+    allocInfo.setCommandBufferCount(1);
+
+    vk::Pipeline candidatePipeline = BuildComputePipeline(constants);
+
+    vk::CommandBuffer commandBuffer;
+    logicalDevice.allocateCommandBuffers(&allocInfo, &commandBuffer);
+
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.setFlags(vk::CommandBufferUsageFlags(vk::CommandBufferUsageFlagBits::eSimultaneousUse));
+
+    commandBuffer.begin(beginInfo);
+    commandBuffer.resetQueryPool(queryPool, 0, 2);
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, queryPool, 0);
+
+    vk::MemoryBarrier memoryBarrier;
+    memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+    memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite);
+
+    for (uint32_t iteration = 0; iteration < TUNE_ITERATIONS; iteration++) {
+        RecordComputeCommands(commandBuffer, candidatePipeline);
+
+        // Serialize iterations the same way consecutive frames are
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eDrawIndirect, vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+            vk::DependencyFlags(0), 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, 1);
+    commandBuffer.end();
+
+    vk::SubmitInfo submitInfo;
+    submitInfo.setCommandBufferCount(1);
+    submitInfo.setPCommandBuffers(&commandBuffer);
+
+    // Submit twice and keep the second timing, so the first run absorbs any warm-up cost
+    uint64_t timestamps[2] = {};
+    for (int run = 0; run < 2; run++) {
+        device->GetQueue(QueueFlags::Compute).submit(submitInfo, nullptr);
+        device->GetQueue(QueueFlags::Compute).waitIdle();
+    }
+    logicalDevice.getQueryPoolResults(queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+
+    double time = ((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod * 1e-6 / TUNE_ITERATIONS;
+
+    logicalDevice.freeCommandBuffers(computeCommandPool, 1, &commandBuffer);
+    logicalDevice.destroyPipeline(candidatePipeline);
+
+    return time;
+}
+
+uint32_t Renderer::CountLiveBlades() {
+    uint32_t count = 0;
+    for (Blades* blades : scene->GetBlades()) {
+        std::vector<BladeTile> tiles(blades->GetTileCount());
+        BufferUtils::ReadBufferToData(device, graphicsCommandPool, blades->GetTilesBuffer(), tiles.size() * sizeof(BladeTile), tiles.data());
+        for (const BladeTile& tile : tiles) {
+            count += tile.bladeCount;
+        }
+    }
+    return count;
+}
+
+uint32_t Renderer::CountKeptBlades() {
+    // The culling pass of the last dispatch left the blades it kept as instance counts of the draws
+    uint32_t count = 0;
+    for (Blades* blades : scene->GetBlades()) {
+        std::array<BladeDrawIndirect, BLADE_DRAW_COUNT> draws;
+        BufferUtils::ReadBufferToData(device, graphicsCommandPool, blades->GetNumBladesBuffer(), draws.size() * sizeof(BladeDrawIndirect), draws.data());
+        for (const BladeDrawIndirect& draw : draws) {
+            count += draw.instanceCount;
+        }
+    }
+    return count;
+}
+
+void Renderer::CreateFrameResources() {
+    imageViews.resize(swapChain->GetCount());
+
+    for (uint32_t i = 0; i < swapChain->GetCount(); i++) {
+        // --- Create an image view for each swap chain image ---
+        vk::ImageViewCreateInfo createInfo;
+        createInfo.setImage(swapChain->GetVkImage(i));
+      
+        // Specify how the image data should be interpreted
+        createInfo.setViewType(vk::ImageViewType::e2D);
+        createInfo.setFormat(swapChain->GetVkImageFormat());
+
+        // Specify color channel mappings (can be used for swizzling)
+        createInfo.components.r = vk::ComponentSwizzle::eIdentity;
         createInfo.components.g = vk::ComponentSwizzle::eIdentity;
         createInfo.components.b = vk::ComponentSwizzle::eIdentity;
         createInfo.components.a = vk::ComponentSwizzle::eIdentity;
@@ -934,14 +1771,14 @@ void Renderer::CreateFrameResources() {
     }
 
     vk::Format depthFormat = device->GetInstance()->GetSupportedFormat({ vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint },
-        vk::ImageTiling::eOptimal, vk::FormatFeatureFlags(vk::FormatFeatureFlagBits::eDepthStencilAttachment));
+        vk::ImageTiling::eOptimal, vk::FormatFeatureFlags(vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage));
     // CREATE DEPTH IMAGE
     Image::Create(device,
         swapChain->GetVkExtent().width,
         swapChain->GetVkExtent().height,
         depthFormat,
         vk::ImageTiling::eOptimal,
-        vk::ImageUsageFlags(vk::ImageUsageFlagBits::eDepthStencilAttachment),
+        vk::ImageUsageFlags(vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled),
         vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eDeviceLocal),
         depthImage,
         depthImageMemory
@@ -976,6 +1813,197 @@ void Renderer::CreateFrameResources() {
             throw std::runtime_error("Failed to create framebuffer");
         }
     }
+
+    CreateHiZFrameResources();
+    CreateGrassQueries();
+}
+
+void Renderer::CreateGrassQueries() {
+    ResetGrassTimings();
+
+    // Tessellation counters can only be queried when the feature is enabled
+    statisticsQueryPool = nullptr;
+    if (ENABLE_PIPELINE_STATISTICS && device->GetInstance()->GetPhysicalDevice().getFeatures().pipelineStatisticsQuery) {
+        vk::QueryPipelineStatisticFlags statistics;
+        statisticsCount = 0;
+        for (const PipelineStatistic& counter : PIPELINE_STATISTICS_COUNTERS) {
+            if (!counter.tessellation || tessellationSupported) {
+                statistics |= counter.flag;
+                statisticsCount++;
+            }
+        }
+        statisticsTotals.assign(2 * statisticsCount, 0);
+
+        vk::QueryPoolCreateInfo statisticsPoolInfo;
+        statisticsPoolInfo.setQueryType(vk::QueryType::ePipelineStatistics);
+        statisticsPoolInfo.setQueryCount(2 * swapChain->GetCount());
+        statisticsPoolInfo.setPipelineStatistics(statistics);
+
+        try {
+            statisticsQueryPool = logicalDevice.createQueryPool(statisticsPoolInfo);
+        }
+        catch (vk::SystemError err) {
+            throw std::runtime_error("Failed to create pipeline statistics query pool");
+        }
+    }
+
+    uint32_t timestampValidBits = device->GetInstance()->GetPhysicalDevice().getQueueFamilyProperties()[device->GetQueueIndex(QueueFlags::Graphics)].timestampValidBits;
+    if (timestampValidBits == 0) {
+        grassTimestampQueryPool = nullptr;
+        return;
+    }
+    timestampMask = timestampValidBits >= 64 ? ~0ull : ((1ull << timestampValidBits) - 1);
+
+    vk::QueryPoolCreateInfo queryPoolInfo;
+    queryPoolInfo.setQueryType(vk::QueryType::eTimestamp);
+    queryPoolInfo.setQueryCount(2 * swapChain->GetCount());
+
+    try {
+        grassTimestampQueryPool = logicalDevice.createQueryPool(queryPoolInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create grass timestamp query pool");
+    }
+}
+
+void Renderer::CreateHiZFrameResources() {
+    uint32_t width = swapChain->GetVkExtent().width;
+    uint32_t height = swapChain->GetVkExtent().height;
+    hiZMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+
+    // Level 0 matches the depth buffer, each level below halves it (rounding down)
+    Image::Create(device, width, height, hiZMipLevels,
+        vk::Format::eR32Sfloat,
+        vk::ImageTiling::eOptimal,
+        vk::ImageUsageFlags(vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled),
+        vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eDeviceLocal),
+        hiZImage,
+        hiZImageMemory
+    );
+
+    // Stays in general layout: each level is written as a storage image and read through a sampler
+    Image::TransitionLayout(device, graphicsCommandPool, hiZImage, vk::Format::eR32Sfloat, hiZMipLevels, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
+    hiZImageView = Image::CreateView(device, hiZImage, vk::Format::eR32Sfloat, vk::ImageAspectFlags(vk::ImageAspectFlagBits::eColor), hiZMipLevels);
+
+    hiZLevelViews.resize(hiZMipLevels);
+    for (uint32_t level = 0; level < hiZMipLevels; level++) {
+        vk::ImageViewCreateInfo createInfo;
+        createInfo.setImage(hiZImage);
+        createInfo.setViewType(vk::ImageViewType::e2D);
+        createInfo.setFormat(vk::Format::eR32Sfloat);
+        createInfo.subresourceRange.aspectMask = vk::ImageAspectFlags(vk::ImageAspectFlagBits::eColor);
+        createInfo.subresourceRange.baseMipLevel = level;
+        createInfo.subresourceRange.levelCount = 1;
+        createInfo.subresourceRange.baseArrayLayer = 0;
+        createInfo.subresourceRange.layerCount = 1;
+
+        try {
+            hiZLevelViews[level] = logicalDevice.createImageView(createInfo);
+        }
+        catch (vk::SystemError err) {
+            throw std::runtime_error("Failed to create Hi-Z level views");
+        }
+    }
+
+    // One build set per level plus the occlusion set used by the culling passes
+    std::vector<vk::DescriptorPoolSize> poolSizes = {
+        { vk::DescriptorType::eCombinedImageSampler, hiZMipLevels + 1 },
+        { vk::DescriptorType::eStorageImage, hiZMipLevels },
+        { vk::DescriptorType::eUniformBuffer, 1 }
+    };
+
+    vk::DescriptorPoolCreateInfo poolInfo;
+    poolInfo.setPoolSizeCount(static_cast<uint32_t>(poolSizes.size()));
+    poolInfo.setPPoolSizes(poolSizes.data());
+    poolInfo.setMaxSets(hiZMipLevels + 1);
+
+    try {
+        frameDescriptorPool = logicalDevice.createDescriptorPool(poolInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create frame descriptor pool");
+    }
+
+    std::vector<vk::DescriptorSetLayout> hiZLayouts(hiZMipLevels, hiZDescriptorSetLayout);
+    vk::DescriptorSetAllocateInfo hiZAllocInfo;
+    hiZAllocInfo.setDescriptorPool(frameDescriptorPool);
+    hiZAllocInfo.setDescriptorSetCount(hiZMipLevels);
+    hiZAllocInfo.setPSetLayouts(hiZLayouts.data());
+
+    vk::DescriptorSetAllocateInfo occlusionAllocInfo;
+    occlusionAllocInfo.setDescriptorPool(frameDescriptorPool);
+    occlusionAllocInfo.setDescriptorSetCount(1);
+    occlusionAllocInfo.setPSetLayouts(&occlusionDescriptorSetLayout);
+
+    try {
+        hiZDescriptorSets = logicalDevice.allocateDescriptorSets(hiZAllocInfo);
+        logicalDevice.allocateDescriptorSets(&occlusionAllocInfo, &occlusionDescriptorSet);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to allocate Hi-Z descriptor sets");
+    }
+
+    for (uint32_t level = 0; level < hiZMipLevels; level++) {
+        vk::DescriptorImageInfo srcInfo;
+        srcInfo.setSampler(hiZSampler);
+        srcInfo.setImageView(level == 0 ? depthImageView : hiZLevelViews[level - 1]);
+        srcInfo.setImageLayout(level == 0 ? vk::ImageLayout::eDepthStencilReadOnlyOptimal : vk::ImageLayout::eGeneral);
+
+        vk::DescriptorImageInfo dstInfo;
+        dstInfo.setImageView(hiZLevelViews[level]);
+        dstInfo.setImageLayout(vk::ImageLayout::eGeneral);
+
+        std::array<vk::WriteDescriptorSet, 2> descriptorWrites;
+        descriptorWrites[0].setDstSet(hiZDescriptorSets[level]);
+        descriptorWrites[0].setDstBinding(0);
+        descriptorWrites[0].setDstArrayElement(0);
+        descriptorWrites[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+        descriptorWrites[0].setDescriptorCount(1);
+        descriptorWrites[0].setPImageInfo(&srcInfo);
+
+        descriptorWrites[1].setDstSet(hiZDescriptorSets[level]);
+        descriptorWrites[1].setDstBinding(1);
+        descriptorWrites[1].setDstArrayElement(0);
+        descriptorWrites[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+        descriptorWrites[1].setDescriptorCount(1);
+        descriptorWrites[1].setPImageInfo(&dstInfo);
+
+        logicalDevice.updateDescriptorSets(static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    vk::DescriptorBufferInfo occlusionBufferInfo;
+    occlusionBufferInfo.setBuffer(occlusionBuffer);
+    occlusionBufferInfo.setOffset(0);
+    occlusionBufferInfo.setRange(sizeof(OcclusionBufferObject));
+
+    vk::DescriptorImageInfo hiZInfo;
+    hiZInfo.setSampler(hiZSampler);
+    hiZInfo.setImageView(hiZImageView);
+    hiZInfo.setImageLayout(vk::ImageLayout::eGeneral);
+
+    std::array<vk::WriteDescriptorSet, 2> descriptorWrites;
+    descriptorWrites[0].setDstSet(occlusionDescriptorSet);
+    descriptorWrites[0].setDstBinding(0);
+    descriptorWrites[0].setDstArrayElement(0);
+    descriptorWrites[0].setDescriptorType(vk::DescriptorType::eUniformBuffer);
+    descriptorWrites[0].setDescriptorCount(1);
+    descriptorWrites[0].setPBufferInfo(&occlusionBufferInfo);
+
+    descriptorWrites[1].setDstSet(occlusionDescriptorSet);
+    descriptorWrites[1].setDstBinding(1);
+    descriptorWrites[1].setDstArrayElement(0);
+    descriptorWrites[1].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    descriptorWrites[1].setDescriptorCount(1);
+    descriptorWrites[1].setPImageInfo(&hiZInfo);
+
+    logicalDevice.updateDescriptorSets(static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+    // The new pyramid is empty until a frame has been drawn
+    hiZValid = false;
+    occlusionBufferObject.size = glm::vec2(width, height);
+    occlusionBufferObject.mipLevels = hiZMipLevels;
+    occlusionBufferObject.enabled = 0;
+    memcpy(occlusionMappedData, &occlusionBufferObject, sizeof(OcclusionBufferObject));
 }
 
 void Renderer::DestroyFrameResources() {
@@ -990,20 +2018,53 @@ void Renderer::DestroyFrameResources() {
     for (size_t i = 0; i < framebuffers.size(); i++) {
         logicalDevice.destroyFramebuffer(framebuffers[i]);
     }
+
+    logicalDevice.destroyDescriptorPool(frameDescriptorPool);
+    logicalDevice.destroyQueryPool(grassTimestampQueryPool);
+    logicalDevice.destroyQueryPool(statisticsQueryPool);
+    for (size_t i = 0; i < hiZLevelViews.size(); i++) {
+        logicalDevice.destroyImageView(hiZLevelViews[i]);
+    }
+    logicalDevice.destroyImageView(hiZImageView);
+    logicalDevice.freeMemory(hiZImageMemory);
+    logicalDevice.destroyImage(hiZImage);
 }
 
 void Renderer::RecreateFrameResources() {
+    // Frame calls this after a failed acquire or present, with command buffers still in flight that use the
+    // pipelines, the occlusion set and the frame resources destroyed below
+    logicalDevice.waitIdle();
+
+    std::lock_guard<std::mutex> lock(reloadMutex);
+
+    // Reloaded graphics pipelines were built against the old extent; the ones created below load the new shaders anyway
+    for (auto it = reloadedPipelines.begin(); it != reloadedPipelines.end();) {
+        if (it->first == &graphicsPipeline || it->first == &terrainPipeline || it->first == &grassPipeline || it->first == &grassNearStripPipeline || it->first == &grassLowPolyPipeline || it->first == &grassImpostorPipeline) {
+            logicalDevice.destroyPipeline(it->second);
+            it = reloadedPipelines.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
     logicalDevice.destroyPipeline(graphicsPipeline);
+    logicalDevice.destroyPipeline(terrainPipeline);
     logicalDevice.destroyPipeline(grassPipeline);
+    logicalDevice.destroyPipeline(grassNearStripPipeline);
+    logicalDevice.destroyPipeline(grassLowPolyPipeline);
+    logicalDevice.destroyPipeline(grassImpostorPipeline);
     logicalDevice.destroyPipelineLayout(graphicsPipelineLayout);
+    logicalDevice.destroyPipelineLayout(terrainPipelineLayout);
     logicalDevice.destroyPipelineLayout(grassPipelineLayout);
     logicalDevice.freeCommandBuffers(graphicsCommandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+    logicalDevice.freeCommandBuffers(computeCommandPool, 1, &computeCommandBuffer);
   
     DestroyFrameResources();
     CreateFrameResources();
     CreateGraphicsPipeline();
     CreateGrassPipeline();
     RecordCommandBuffers();
+    RecordComputeCommandBuffer();
 }
 
 void Renderer::RecordComputeCommandBuffer() {
@@ -1032,27 +2093,65 @@ void Renderer::RecordComputeCommandBuffer() {
         throw std::runtime_error("Failed to begin recording compute command buffer");
     }
 
-    // Bind to the compute pipeline
-    computeCommandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline);
+    RecordComputeCommands(computeCommandBuffer, computePipeline);
+
+    // ~ End recording ~
+    try {
+        computeCommandBuffer.end();
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to end record compute command buffer");
+    }
+}
+
+void Renderer::RecordComputeCommands(vk::CommandBuffer commandBuffer, vk::Pipeline bladePipeline) {
+    // Reset the visible tile counter and the blade count of every draw.
+    // Far bins count down from the end of their tier, the culling pass lowers their first instance with atomicMin.
+    for (Blades* blades : scene->GetBlades()) {
+        for (uint32_t draw = 0; draw < BLADE_DRAW_COUNT; draw++) {
+            commandBuffer.fillBuffer(blades->GetNumBladesBuffer(), draw * sizeof(BladeDrawIndirect) + offsetof(BladeDrawIndirect, instanceCount), sizeof(uint32_t), 0);
+            if (draw % BLADE_DEPTH_BIN_COUNT == BLADE_DEPTH_FAR) {
+                uint32_t firstInstance = computeConstants.depthBinning ? blades->GetBladeCount() : 0;
+                commandBuffer.fillBuffer(blades->GetNumBladesBuffer(), draw * sizeof(BladeDrawIndirect) + offsetof(BladeDrawIndirect, firstInstance), sizeof(uint32_t), firstInstance);
+            }
+        }
+        commandBuffer.fillBuffer(blades->GetDispatchIndirectBuffer(), 0, sizeof(uint32_t), 0);
+    }
+
+    vk::MemoryBarrier resetBarrier;
+    resetBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    resetBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(0), 1, &resetBarrier, 0, nullptr, 0, nullptr);
 
     // Bind camera descriptor set
-    computeCommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, computePipelineLayout, 0, 1, &cameraDescriptorSet, 0, nullptr);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, computePipelineLayout, 0, 1, &cameraDescriptorSet, 0, nullptr);
 
     // Bind descriptor set for time uniforms
-    computeCommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, computePipelineLayout, 1, 1, &timeDescriptorSet, 0, nullptr);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, computePipelineLayout, 1, 1, &timeDescriptorSet, 0, nullptr);
+
+    // Bind the Hi-Z pyramid for the occlusion test
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, computePipelineLayout, 3, 1, &occlusionDescriptorSet, 0, nullptr);
 
-    // For each group of blades bind its descriptor set and dispatch
+    // Cull whole tiles first, writing the indirect dispatch arguments for the blade pass.
+    // One dispatch covers every patch of a Blades pool; empty patches hold only empty tiles.
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, tileCullPipeline);
     for (int i = 0; i < computeDescriptorSets.size(); i++) {
-        computeCommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, computePipelineLayout, 2, 1, &computeDescriptorSets[i], 0, nullptr);
-        computeCommandBuffer.dispatch(NUM_BLADES / WORKGROUP_SIZE + 1, 1, 1);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, computePipelineLayout, 2, 1, &computeDescriptorSets[i], 0, nullptr);
+        commandBuffer.dispatch((scene->GetBlades()[i]->GetTileCount() + 31) / 32, 1, 1);
     }
 
-    // ~ End recording ~
-    try {
-        computeCommandBuffer.end();
-    }
-    catch (vk::SystemError err) {
-        throw std::runtime_error("Failed to end record compute command buffer");
+    vk::MemoryBarrier tileBarrier;
+    tileBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+    tileBarrier.setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(0), 1, &tileBarrier, 0, nullptr, 0, nullptr);
+
+    // One workgroup per visible tile
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, bladePipeline);
+    for (int i = 0; i < computeDescriptorSets.size(); i++) {
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, computePipelineLayout, 2, 1, &computeDescriptorSets[i], 0, nullptr);
+        commandBuffer.dispatchIndirect(scene->GetBlades()[i]->GetDispatchIndirectBuffer(), 0);
     }
 }
 
@@ -1099,15 +2198,17 @@ void Renderer::RecordCommandBuffers() {
         renderPassInfo.setClearValueCount(static_cast<uint32_t>(clearValues.size()));
         renderPassInfo.setPClearValues(clearValues.data());
          
-        std::vector<vk::BufferMemoryBarrier> barriers(scene->GetBlades().size());
-        for (uint32_t j = 0; j < barriers.size(); ++j) {
-            barriers[j].setSrcAccessMask(vk::AccessFlags(vk::AccessFlagBits::eShaderWrite));
-            barriers[j].setDstAccessMask(vk::AccessFlags(vk::AccessFlagBits::eIndirectCommandRead));
-            barriers[j].setSrcQueueFamilyIndex(device->GetQueueIndex(QueueFlags::Compute));
-            barriers[j].setDstQueueFamilyIndex(device->GetQueueIndex(QueueFlags::Graphics));
-            barriers[j].setBuffer(scene->GetBlades()[j]->GetNumBladesBuffer());
-            barriers[j].setOffset(0);
-            barriers[j].setSize(sizeof(BladeDrawIndirect));
+        std::vector<vk::BufferMemoryBarrier> barriers;
+        for (Blades* blades : scene->GetBlades()) {
+            vk::BufferMemoryBarrier barrier;
+            barrier.setSrcAccessMask(vk::AccessFlags(vk::AccessFlagBits::eShaderWrite));
+            barrier.setDstAccessMask(vk::AccessFlags(vk::AccessFlagBits::eIndirectCommandRead));
+            barrier.setSrcQueueFamilyIndex(device->GetQueueIndex(QueueFlags::Compute));
+            barrier.setDstQueueFamilyIndex(device->GetQueueIndex(QueueFlags::Graphics));
+            barrier.setBuffer(blades->GetNumBladesBuffer());
+            barrier.setOffset(0);
+            barrier.setSize(BLADE_DRAW_COUNT * sizeof(BladeDrawIndirect));
+            barriers.push_back(barrier);
         }
 
         commandBuffers[i].pipelineBarrier(vk::PipelineStageFlags(vk::PipelineStageFlagBits::eComputeShader), 
@@ -1115,6 +2216,13 @@ void Renderer::RecordCommandBuffers() {
             vk::DependencyFlags(0),
             0, nullptr, barriers.size(), barriers.data(), 0, nullptr);
 
+        if (grassTimestampQueryPool) {
+            commandBuffers[i].resetQueryPool(grassTimestampQueryPool, 2 * i, 2);
+        }
+        if (statisticsQueryPool) {
+            commandBuffers[i].resetQueryPool(statisticsQueryPool, 2 * i, 2);
+        }
+
         // Bind the camera descriptor set. This is set 0 in all pipelines so it will be inherited
         commandBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, graphicsPipelineLayout, 0, 1, &cameraDescriptorSet, 0, nullptr);
 
@@ -1123,6 +2231,10 @@ void Renderer::RecordCommandBuffers() {
         // Bind the graphics pipeline
         commandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline);
 
+        if (statisticsQueryPool) {
+            commandBuffers[i].beginQuery(statisticsQueryPool, 2 * i, vk::QueryControlFlags());
+        }
+
         for (uint32_t j = 0; j < scene->GetModels().size(); ++j) {
             // Bind the vertex and index buffers
             std::array<vk::Buffer, 1> vertexBuffers = { scene->GetModels()[j]->getVertexBuffer() };
@@ -1139,23 +2251,71 @@ void Renderer::RecordCommandBuffers() {
             commandBuffers[i].drawIndexed(static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
         }
 
-        // Bind the grass pipeline
-        commandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, grassPipeline);
+        if (Terrain* terrain = scene->GetTerrain()) {
+            commandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, terrainPipeline);
 
-        for (uint32_t j = 0; j < scene->GetBlades().size(); ++j) {
-            std::array<vk::Buffer, 1> vertexBuffers = { scene->GetBlades()[j]->GetCulledBladesBuffer() };
+            std::array<vk::Buffer, 1> vertexBuffers = { terrain->getVertexBuffer() };
             std::array<vk::DeviceSize, 1> offsets = { 0 };
             commandBuffers[i].bindVertexBuffers(0, 1, vertexBuffers.data(), offsets.data());
+            commandBuffers[i].bindIndexBuffer(terrain->getIndexBuffer(), 0, vk::IndexType::eUint32);
+            commandBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, terrainPipelineLayout, 1, 1, &terrainDescriptorSet, 0, nullptr);
+            commandBuffers[i].drawIndexed(static_cast<uint32_t>(terrain->getIndices().size()), 1, 0, 0, 0);
+        }
 
-            // Bind the descriptor set for each grass blades model
-            commandBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, grassPipelineLayout, 1, 1, &grassDescriptorSets[j], 0, nullptr);
-            // Draw
-            commandBuffers[i].drawIndirect(scene->GetBlades()[j]->GetNumBladesBuffer(), 0, 1, sizeof(BladeDrawIndirect));
+        if (statisticsQueryPool) {
+            commandBuffers[i].endQuery(statisticsQueryPool, 2 * i);
+        }
+
+        if (grassTimestampQueryPool) {
+            commandBuffers[i].writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, grassTimestampQueryPool, 2 * i);
+        }
+        if (statisticsQueryPool) {
+            commandBuffers[i].beginQuery(statisticsQueryPool, 2 * i + 1, vk::QueryControlFlags());
+        }
+
+        // Draw each LOD tier with its own pipeline, from its own range of the culled blades buffer.
+        // Tiers and the depth bins within them go from near to far, so nearer blades reject the ones behind them early.
+        // The bins of a tier are adjacent draws, issued with a single multi-draw where the device supports it.
+        vk::Pipeline nearPipeline = grassGeometry == GrassGeometry::Tessellation ? grassPipeline : grassNearStripPipeline;
+        std::array<vk::Pipeline, BLADE_LOD_COUNT> lodPipelines = { nearPipeline, grassLowPolyPipeline, grassImpostorPipeline };
+        for (uint32_t lod = 0; lod < BLADE_LOD_COUNT; lod++) {
+            commandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, lodPipelines[lod]);
+
+            for (uint32_t j = 0; j < scene->GetBlades().size(); ++j) {
+                Blades* blades = scene->GetBlades()[j];
+                std::array<vk::Buffer, 1> vertexBuffers = { blades->GetCulledBladesBuffer() };
+                std::array<vk::DeviceSize, 1> offsets = { lod * blades->GetBladeCount() * sizeof(CulledBlade) };
+                commandBuffers[i].bindVertexBuffers(0, 1, vertexBuffers.data(), offsets.data());
+
+                // Bind the descriptor set for each grass blades model
+                commandBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, grassPipelineLayout, 1, 1, &grassDescriptorSets[j], 0, nullptr);
+
+                // Draw
+                vk::DeviceSize tierOffset = lod * BLADE_DEPTH_BIN_COUNT * sizeof(BladeDrawIndirect);
+                if (multiDrawIndirectSupported) {
+                    commandBuffers[i].drawIndirect(blades->GetNumBladesBuffer(), tierOffset, BLADE_DEPTH_BIN_COUNT, sizeof(BladeDrawIndirect));
+                }
+                else {
+                    for (uint32_t bin = 0; bin < BLADE_DEPTH_BIN_COUNT; bin++) {
+                        commandBuffers[i].drawIndirect(blades->GetNumBladesBuffer(), tierOffset + bin * sizeof(BladeDrawIndirect), 1, sizeof(BladeDrawIndirect));
+                    }
+                }
+            }
+        }
+
+        if (statisticsQueryPool) {
+            commandBuffers[i].endQuery(statisticsQueryPool, 2 * i + 1);
+        }
+        if (grassTimestampQueryPool) {
+            commandBuffers[i].writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, grassTimestampQueryPool, 2 * i + 1);
         }
 
         // End render pass
         commandBuffers[i].endRenderPass();
 
+        // Reduce this frame's depth for next frame's occlusion culling
+        RecordHiZCommands(commandBuffers[i]);
+
         // ~ End recording ~
         try {
             commandBuffers[i].end();
@@ -1166,13 +2326,279 @@ void Renderer::RecordCommandBuffers() {
     }
 }
 
+void Renderer::RecordHiZCommands(vk::CommandBuffer commandBuffer) {
+    // The culling passes of earlier frames may still be sampling the pyramid
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(0), 0, nullptr, 0, nullptr, 0, nullptr);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, hiZPipeline);
+
+    vk::ImageMemoryBarrier levelBarrier;
+    levelBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+    levelBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    levelBarrier.setOldLayout(vk::ImageLayout::eGeneral);
+    levelBarrier.setNewLayout(vk::ImageLayout::eGeneral);
+    levelBarrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    levelBarrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    levelBarrier.setImage(hiZImage);
+    levelBarrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+    levelBarrier.subresourceRange.levelCount = 1;
+    levelBarrier.subresourceRange.baseArrayLayer = 0;
+    levelBarrier.subresourceRange.layerCount = 1;
+
+    // Each level reads the one written just before it
+    for (uint32_t level = 0; level < hiZMipLevels; level++) {
+        uint32_t width = std::max(swapChain->GetVkExtent().width >> level, 1u);
+        uint32_t height = std::max(swapChain->GetVkExtent().height >> level, 1u);
+
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, hiZPipelineLayout, 0, 1, &hiZDescriptorSets[level], 0, nullptr);
+        commandBuffer.dispatch((width + 7) / 8, (height + 7) / 8, 1);
+
+        levelBarrier.subresourceRange.baseMipLevel = level;
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags(0), 0, nullptr, 0, nullptr, 1, &levelBarrier);
+    }
+}
+
+void Renderer::WatchShaders() {
+    shaderWatcher = new ShaderWatcher(std::chrono::milliseconds(500));
+
+    // Rebuild only the pipeline whose shaders changed, on the watcher thread
+    auto reload = [this](vk::Pipeline* target, std::function<vk::Pipeline()> build) {
+        return [this, target, build]() {
+            std::lock_guard<std::mutex> lock(reloadMutex);
+            try {
+                reloadedPipelines.push_back({ target, build() });
+            }
+            catch (std::exception& err) {
+                fprintf(stderr, "Shader reload failed: %s\n", err.what());
+            }
+        };
+    };
+
+    shaderWatcher->Watch({ "shaders/graphics.vert.spv", "shaders/graphics.frag.spv" },
+        reload(&graphicsPipeline, [this]() { return BuildGraphicsPipeline("shaders/graphics.vert.spv", "shaders/graphics.frag.spv", graphicsPipelineLayout); }));
+    shaderWatcher->Watch({ "shaders/terrain.vert.spv", "shaders/terrain.frag.spv" },
+        reload(&terrainPipeline, [this]() { return BuildGraphicsPipeline("shaders/terrain.vert.spv", "shaders/terrain.frag.spv", terrainPipelineLayout); }));
+    if (tessellationSupported) {
+        shaderWatcher->Watch({ "shaders/grass.vert.spv", "shaders/grass.tesc.spv", "shaders/grass.tese.spv", "shaders/grass.frag.spv" },
+            reload(&grassPipeline, [this]() { return BuildGrassPipeline(); }));
+    }
+    shaderWatcher->Watch({ "shaders/grass_strip.vert.spv", "shaders/grass.frag.spv" },
+        reload(&grassNearStripPipeline, [this]() { return BuildGrassStripPipeline("shaders/grass_strip.vert.spv", "shaders/grass.frag.spv", NEAR_STRIP_SEGMENTS); }));
+    shaderWatcher->Watch({ "shaders/grass_strip.vert.spv", "shaders/grass.frag.spv" },
+        reload(&grassLowPolyPipeline, [this]() { return BuildGrassStripPipeline("shaders/grass_strip.vert.spv", "shaders/grass.frag.spv", LOW_POLY_SEGMENTS); }));
+    shaderWatcher->Watch({ "shaders/grass_impostor.vert.spv", "shaders/grass_impostor.frag.spv" },
+        reload(&grassImpostorPipeline, [this]() { return BuildGrassStripPipeline("shaders/grass_impostor.vert.spv", "shaders/grass_impostor.frag.spv"); }));
+    shaderWatcher->Watch({ "shaders/compute.comp.spv" },
+        reload(&computePipeline, [this]() { return BuildComputePipeline(computeConstants); }));
+    shaderWatcher->Watch({ "shaders/tiles.comp.spv" },
+        reload(&tileCullPipeline, [this]() { return BuildTileCullPipeline(computeConstants); }));
+    shaderWatcher->Watch({ "shaders/hiz.comp.spv" },
+        reload(&hiZPipeline, [this]() { return BuildHiZPipeline(); }));
+    shaderWatcher->Start();
+}
+
+void Renderer::SwapReloadedPipelines() {
+    // Don't stall the frame while the watcher is still compiling
+    std::unique_lock<std::mutex> lock(reloadMutex, std::try_to_lock);
+    if (!lock.owns_lock() || reloadedPipelines.empty()) {
+        return;
+    }
+
+    // The old pipelines may still be referenced by in-flight command buffers
+    logicalDevice.waitIdle();
+
+    for (auto& reloaded : reloadedPipelines) {
+        logicalDevice.destroyPipeline(*reloaded.first);
+        *reloaded.first = reloaded.second;
+    }
+    reloadedPipelines.clear();
+
+    // Command buffers are prerecorded with the pipeline handles baked in
+    logicalDevice.freeCommandBuffers(graphicsCommandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+    logicalDevice.freeCommandBuffers(computeCommandPool, 1, &computeCommandBuffer);
+    RecordCommandBuffers();
+    RecordComputeCommandBuffer();
+}
+
+void Renderer::SetGrassGeometry(GrassGeometry geometry) {
+    if (geometry == GrassGeometry::Tessellation && !tessellationSupported) {
+        fprintf(stderr, "Tessellation is not supported by this device\n");
+        return;
+    }
+
+    if (geometry != grassGeometry) {
+        grassGeometry = geometry;
+        grassGeometryChanged = true;
+    }
+}
+
+GrassGeometry Renderer::GetGrassGeometry() const {
+    return grassGeometry;
+}
+
+void Renderer::SetDepthBinning(bool enabled) {
+    if (enabled && !depthBinningSupported) {
+        fprintf(stderr, "Depth binning needs drawIndirectFirstInstance, which this device doesn't support\n");
+        return;
+    }
+
+    if (enabled != (computeConstants.depthBinning == VK_TRUE)) {
+        // The watcher thread builds compute pipelines from these constants while holding the lock
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        computeConstants.depthBinning = enabled ? VK_TRUE : VK_FALSE;
+        depthBinningChanged = true;
+    }
+}
+
+bool Renderer::GetDepthBinning() const {
+    return computeConstants.depthBinning == VK_TRUE;
+}
+
+void Renderer::UpdateNearTierVertexCount() {
+    // A tessellated blade is a single patch vertex, a strip blade needs both edges of every segment plus the tip
+    uint32_t vertexCount = grassGeometry == GrassGeometry::Tessellation ? BLADE_LOD_VERTEX_COUNTS[BLADE_LOD_TESSELLATED] : 2 * NEAR_STRIP_SEGMENTS + 1;
+
+    vk::CommandBufferAllocateInfo allocInfo;
+    allocInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+    allocInfo.setCommandPool(graphicsCommandPool);
+    allocInfo.setCommandBufferCount(1);
+
+    vk::CommandBuffer commandBuffer;
+    logicalDevice.allocateCommandBuffers(&allocInfo, &commandBuffer);
+
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.setFlags(vk::CommandBufferUsageFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+    commandBuffer.begin(beginInfo);
+    for (Blades* blades : scene->GetBlades()) {
+        for (uint32_t bin = 0; bin < BLADE_DEPTH_BIN_COUNT; bin++) {
+            uint32_t draw = BLADE_LOD_TESSELLATED * BLADE_DEPTH_BIN_COUNT + bin;
+            commandBuffer.updateBuffer(blades->GetNumBladesBuffer(), draw * sizeof(BladeDrawIndirect) + offsetof(BladeDrawIndirect, vertexCount), sizeof(uint32_t), &vertexCount);
+        }
+    }
+    commandBuffer.end();
+
+    vk::SubmitInfo submitInfo;
+    submitInfo.setCommandBufferCount(1);
+    submitInfo.setPCommandBuffers(&commandBuffer);
+
+    device->GetQueue(QueueFlags::Graphics).submit(submitInfo, nullptr);
+    device->GetQueue(QueueFlags::Graphics).waitIdle();
+    logicalDevice.freeCommandBuffers(graphicsCommandPool, 1, &commandBuffer);
+}
+
+void Renderer::ResetGrassTimings() {
+    grassTimestampsWritten.assign(swapChain->GetCount(), false);
+    grassTimeTotal = 0.0;
+    grassTimeSamples = 0;
+    statisticsTotals.assign(statisticsTotals.size(), 0);
+}
+
+void Renderer::ReadGrassQueries(uint32_t imageIndex) {
+    if (!grassTimestampQueryPool || !grassTimestampsWritten[imageIndex]) {
+        return;
+    }
+
+    // Don't wait, the sample is skipped if the previous submission of this image hasn't finished
+    uint64_t timestamps[2] = {};
+    vk::Result result = logicalDevice.getQueryPoolResults(grassTimestampQueryPool, 2 * imageIndex, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+        return;
+    }
+
+    // Ground counters followed by grass counters
+    std::vector<uint64_t> statistics(2 * statisticsCount);
+    if (statisticsQueryPool) {
+        result = logicalDevice.getQueryPoolResults(statisticsQueryPool, 2 * imageIndex, 2, statistics.size() * sizeof(uint64_t), statistics.data(),
+            statisticsCount * sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess) {
+            return;
+        }
+    }
+
+    float timestampPeriod = device->GetInstance()->GetPhysicalDevice().getProperties().limits.timestampPeriod;
+    grassTimeTotal += ((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod * 1e-6;
+    for (size_t i = 0; i < statistics.size(); i++) {
+        statisticsTotals[i] += statistics[i];
+    }
+    grassTimeSamples++;
+
+    if (grassTimeSamples == GRASS_TIMING_FRAMES) {
+        printf("Grass draw (%s, %s): %.4f ms\n", grassGeometry == GrassGeometry::Tessellation ? "tessellation" : "strips",
+            computeConstants.depthBinning ? "depth binned" : "unsorted", grassTimeTotal / grassTimeSamples);
+        if (statisticsQueryPool) {
+            PrintPipelineStatistics("Ground", statisticsTotals.data(), grassTimeSamples);
+            PrintPipelineStatistics("Grass", statisticsTotals.data() + statisticsCount, grassTimeSamples);
+        }
+        grassTimeTotal = 0.0;
+        grassTimeSamples = 0;
+        statisticsTotals.assign(statisticsTotals.size(), 0);
+    }
+}
+
+void Renderer::PrintPipelineStatistics(const char* label, const uint64_t* totals, uint32_t samples) const {
+    // Per frame invocation counts, tessellation counters are skipped when they weren't queried
+    printf("  %s:", label);
+    uint32_t index = 0;
+    for (const PipelineStatistic& counter : PIPELINE_STATISTICS_COUNTERS) {
+        if (counter.tessellation && !tessellationSupported) {
+            continue;
+        }
+        printf("%s %s %llu", index == 0 ? "" : ",", counter.name, static_cast<unsigned long long>(totals[index] / samples));
+        index++;
+    }
+    printf("\n");
+}
+
+void Renderer::UpdateOcclusionBuffer() {
+    // The previous compute submission reads the same mapped buffer, so it has to be done before this one is written
+    logicalDevice.waitForFences(1, &computeFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    logicalDevice.resetFences(1, &computeFence);
+
+    // Culling tests against the pyramid built from the last frame that was drawn
+    occlusionBufferObject.viewProj = hiZViewProj;
+    occlusionBufferObject.enabled = hiZValid ? 1 : 0;
+    memcpy(occlusionMappedData, &occlusionBufferObject, sizeof(OcclusionBufferObject));
+}
+
 void Renderer::Frame() {
+    SwapReloadedPipelines();
+
+    if (grassGeometryChanged) {
+        grassGeometryChanged = false;
+        logicalDevice.waitIdle();
+
+        UpdateNearTierVertexCount();
+        logicalDevice.freeCommandBuffers(graphicsCommandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+        RecordCommandBuffers();
+
+        // Start the next timing from the new geometry
+        ResetGrassTimings();
+    }
+
+    if (depthBinningChanged) {
+        depthBinningChanged = false;
+        logicalDevice.waitIdle();
+
+        logicalDevice.destroyPipeline(computePipeline);
+        computePipeline = BuildComputePipeline(computeConstants);
+        logicalDevice.freeCommandBuffers(computeCommandPool, 1, &computeCommandBuffer);
+        RecordComputeCommandBuffer();
+
+        ResetGrassTimings();
+    }
+
+    UpdateOcclusionBuffer();
+
     vk::SubmitInfo computeSubmitInfo;
     computeSubmitInfo.setCommandBufferCount(1);
     computeSubmitInfo.setPCommandBuffers(&computeCommandBuffer);
    
     try {
-        device->GetQueue(QueueFlags::Compute).submit(computeSubmitInfo, nullptr);
+        device->GetQueue(QueueFlags::Compute).submit(computeSubmitInfo, computeFence);
     }
     catch (vk::SystemError err) {
         throw std::runtime_error("Failed to submit draw command buffer");
@@ -1183,6 +2609,8 @@ void Renderer::Frame() {
         return;
     }
 
+    ReadGrassQueries(swapChain->GetIndex());
+
     // Submit the command buffer
     vk::SubmitInfo submitDrawInfo;
     
@@ -1195,6 +2623,8 @@ void Renderer::Frame() {
     submitDrawInfo.setCommandBufferCount(1);
     submitDrawInfo.setPCommandBuffers(&commandBuffers[swapChain->GetIndex()]);
 
+    glm::mat4 viewProj = camera->GetViewProjection();
+
     std::array<vk::Semaphore, 1> signalSemaphores = { swapChain->GetRenderFinishedVkSemaphore() };
     submitDrawInfo.setSignalSemaphoreCount(1);
     submitDrawInfo.setPSignalSemaphores(signalSemaphores.data());
@@ -1206,6 +2636,11 @@ void Renderer::Frame() {
         throw std::runtime_error("Failed to submit draw command buffer");
     }
 
+    // The Hi-Z pyramid now holds this frame's depth
+    hiZViewProj = viewProj;
+    hiZValid = true;
+    grassTimestampsWritten[swapChain->GetIndex()] = true;
+
     if (!swapChain->Present()) {
         RecreateFrameResources();
     }
@@ -1214,29 +2649,50 @@ void Renderer::Frame() {
 Renderer::~Renderer() {
     logicalDevice.waitIdle();
 
+    delete shaderWatcher;
+    for (auto& reloaded : reloadedPipelines) {
+        logicalDevice.destroyPipeline(reloaded.second);
+    }
+
     // TODO: destroy any resources you created
 
     logicalDevice.freeCommandBuffers(graphicsCommandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
     logicalDevice.freeCommandBuffers(computeCommandPool, 1, &computeCommandBuffer);
     
     logicalDevice.destroyPipeline(graphicsPipeline);
+    logicalDevice.destroyPipeline(terrainPipeline);
     logicalDevice.destroyPipeline(grassPipeline);
+    logicalDevice.destroyPipeline(grassNearStripPipeline);
+    logicalDevice.destroyPipeline(grassLowPolyPipeline);
+    logicalDevice.destroyPipeline(grassImpostorPipeline);
     logicalDevice.destroyPipeline(computePipeline);
+    logicalDevice.destroyPipeline(tileCullPipeline);
+    logicalDevice.destroyPipeline(hiZPipeline);
 
     logicalDevice.destroyPipelineLayout(graphicsPipelineLayout);
+    logicalDevice.destroyPipelineLayout(terrainPipelineLayout);
     logicalDevice.destroyPipelineLayout(grassPipelineLayout);
     logicalDevice.destroyPipelineLayout(computePipelineLayout);
+    logicalDevice.destroyPipelineLayout(hiZPipelineLayout);
 
     logicalDevice.destroyDescriptorSetLayout(cameraDescriptorSetLayout);
     logicalDevice.destroyDescriptorSetLayout(modelDescriptorSetLayout);
+    logicalDevice.destroyDescriptorSetLayout(terrainDescriptorSetLayout);
     logicalDevice.destroyDescriptorSetLayout(timeDescriptorSetLayout);
     logicalDevice.destroyDescriptorSetLayout(computeDescriptorSetLayout);
+    logicalDevice.destroyDescriptorSetLayout(hiZDescriptorSetLayout);
+    logicalDevice.destroyDescriptorSetLayout(occlusionDescriptorSetLayout);
     
     logicalDevice.destroyDescriptorPool(descriptorPool);
    
     logicalDevice.destroyRenderPass(renderPass);
     
     DestroyFrameResources();
+    logicalDevice.destroySampler(hiZSampler);
+    logicalDevice.unmapMemory(occlusionBufferMemory);
+    logicalDevice.destroyBuffer(occlusionBuffer);
+    logicalDevice.freeMemory(occlusionBufferMemory);
+    logicalDevice.destroyFence(computeFence);
     logicalDevice.destroyCommandPool(computeCommandPool);
     logicalDevice.destroyCommandPool(graphicsCommandPool);
 }
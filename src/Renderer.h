@@ -1,9 +1,45 @@
 #pragma once
 
+#include <mutex>
+#include <string>
+#include <utility>
 #include "Device.h"
 #include "SwapChain.h"
 #include "Scene.h"
 #include "Camera.h"
+#include "ShaderWatcher.h"
+
+// Values baked into compute.comp through specialization constants
+struct ComputeConstants {
+    uint32_t workgroupSize = 32;
+    float distMax = 18.0f;
+    float densityFalloffStart = 4.0f;
+    float orientationThreshold = 0.9f;
+    float frustumTolerance = -0.05f;  // clip-space w offset of the three-point frustum test; the sphere test has no margin
+    float maxWidthScale = 2.5f;
+    float lowPolyDist = 6.0f;
+    float impostorDist = 11.0f;
+    float pixelsPerSegment = 8.0f;  // screen-space length each tessellated segment may cover
+    float maxTessLevel = 12.0f;
+    vk::Bool32 frustumSpheres = VK_TRUE;  // plane tests on a bounding sphere instead of projecting three points per blade
+    vk::Bool32 depthBinning = VK_TRUE;    // near and far draws per LOD tier, needs drawIndirectFirstInstance
+    float restSpeed = 0.05f;              // guide speed per second below which a blade stops being simulated
+    float windWakeAngle = 0.1f;           // wind turn in radians that wakes a resting blade
+};
+
+// How the nearest LOD tier is drawn: tessellated patches, or fixed strips for devices where tessellation is slow or missing
+enum class GrassGeometry {
+    Tessellation,
+    Strips
+};
+
+// Matches OcclusionBufferObject in shaders/occlusion.glsl
+struct OcclusionBufferObject {
+    glm::mat4 viewProj;
+    glm::vec2 size;
+    uint32_t mipLevels;
+    uint32_t enabled;
+};
 
 class Renderer {
 public:
@@ -17,13 +53,17 @@ public:
 
     void CreateCameraDescriptorSetLayout();
     void CreateModelDescriptorSetLayout();
+    void CreateTerrainDescriptorSetLayout();
     void CreateTimeDescriptorSetLayout();
     void CreateComputeDescriptorSetLayout();
+    void CreateOcclusionDescriptorSetLayouts();
+    void CreateOcclusionResources();
 
     void CreateDescriptorPool();
 
     void CreateCameraDescriptorSet();
     void CreateModelDescriptorSets();
+    void CreateTerrainDescriptorSet();
     void CreateGrassDescriptorSets();
     void CreateTimeDescriptorSet();
     void CreateComputeDescriptorSets();
@@ -31,14 +71,42 @@ public:
     void CreateGraphicsPipeline();
     void CreateGrassPipeline();
     void CreateComputePipeline();
+    void CreateHiZPipeline();
+    vk::Pipeline BuildGraphicsPipeline(const std::string& vertShaderPath, const std::string& fragShaderPath, vk::PipelineLayout layout);
+    vk::Pipeline BuildGrassPipeline();
+    vk::Pipeline BuildGrassStripPipeline(const std::string& vertShaderPath, const std::string& fragShaderPath, uint32_t segments = 1);
+    vk::Pipeline BuildComputePipeline(const ComputeConstants& constants);
+    vk::Pipeline BuildTileCullPipeline(const ComputeConstants& constants);
+    vk::Pipeline BuildHiZPipeline();
+    void TuneComputeWorkgroupSize();
+    double BenchmarkComputePipeline(const ComputeConstants& constants, vk::QueryPool queryPool, uint64_t timestampMask);
+    uint32_t CountLiveBlades();
+    uint32_t CountKeptBlades();
 
     void CreateFrameResources();
+    void CreateHiZFrameResources();
+    void CreateGrassQueries();
     void DestroyFrameResources();
     void RecreateFrameResources();
 
     void RecordCommandBuffers();
     void RecordComputeCommandBuffer();
-
+    void RecordComputeCommands(vk::CommandBuffer commandBuffer, vk::Pipeline bladePipeline);
+    void RecordHiZCommands(vk::CommandBuffer commandBuffer);
+
+    void SetGrassGeometry(GrassGeometry geometry);
+    GrassGeometry GetGrassGeometry() const;
+    void UpdateNearTierVertexCount();
+    void SetDepthBinning(bool enabled);
+    bool GetDepthBinning() const;
+    void ResetGrassTimings();
+    void ReadGrassQueries(uint32_t imageIndex);
+    void PrintPipelineStatistics(const char* label, const uint64_t* totals, uint32_t samples) const;
+
+    void WatchShaders();
+    void SwapReloadedPipelines();
+
+    void UpdateOcclusionBuffer();
     void Frame();
 
 private:
@@ -55,24 +123,42 @@ private:
 
     vk::DescriptorSetLayout cameraDescriptorSetLayout;
     vk::DescriptorSetLayout modelDescriptorSetLayout;
+    vk::DescriptorSetLayout terrainDescriptorSetLayout;
     vk::DescriptorSetLayout timeDescriptorSetLayout;
     vk::DescriptorSetLayout computeDescriptorSetLayout;
+    vk::DescriptorSetLayout hiZDescriptorSetLayout;
+    vk::DescriptorSetLayout occlusionDescriptorSetLayout;
     
     vk::DescriptorPool descriptorPool;
 
     vk::DescriptorSet cameraDescriptorSet;
     std::vector<vk::DescriptorSet> modelDescriptorSets;
+    vk::DescriptorSet terrainDescriptorSet;
     vk::DescriptorSet timeDescriptorSet;
     std::vector<vk::DescriptorSet> computeDescriptorSets;
     std::vector<vk::DescriptorSet> grassDescriptorSets;
 
+    // Sets that reference frame resources, reallocated with them
+    vk::DescriptorPool frameDescriptorPool;
+    std::vector<vk::DescriptorSet> hiZDescriptorSets;
+    vk::DescriptorSet occlusionDescriptorSet;
+
     vk::PipelineLayout graphicsPipelineLayout;
+    vk::PipelineLayout terrainPipelineLayout;
     vk::PipelineLayout grassPipelineLayout;
     vk::PipelineLayout computePipelineLayout;
+    vk::PipelineLayout hiZPipelineLayout;
 
     vk::Pipeline graphicsPipeline;
+    vk::Pipeline terrainPipeline;
     vk::Pipeline grassPipeline;
+    vk::Pipeline grassNearStripPipeline;
+    vk::Pipeline grassLowPolyPipeline;
+    vk::Pipeline grassImpostorPipeline;
     vk::Pipeline computePipeline;
+    vk::Pipeline tileCullPipeline;
+    vk::Pipeline hiZPipeline;
+    ComputeConstants computeConstants;
 
     std::vector<vk::ImageView> imageViews;
     vk::Image depthImage;
@@ -80,6 +166,52 @@ private:
     vk::ImageView depthImageView;
     std::vector<vk::Framebuffer> framebuffers;
 
+    // Hi-Z pyramid of the last rendered depth buffer, sampled by the culling passes
+    vk::Image hiZImage;
+    vk::DeviceMemory hiZImageMemory;
+    vk::ImageView hiZImageView;
+    std::vector<vk::ImageView> hiZLevelViews;
+    uint32_t hiZMipLevels;
+    vk::Sampler hiZSampler;
+
+    vk::Buffer occlusionBuffer;
+    vk::DeviceMemory occlusionBufferMemory;
+    void* occlusionMappedData;
+    OcclusionBufferObject occlusionBufferObject;
+
+    // View-projection the pyramid was rendered with; invalid until a frame has been drawn into the current resources
+    glm::mat4 hiZViewProj = glm::mat4(1.0f);
+    bool hiZValid = false;
+
     std::vector<vk::CommandBuffer> commandBuffers;
     vk::CommandBuffer computeCommandBuffer;
+    vk::Fence computeFence;  // signaled once the last submission of computeCommandBuffer completed
+
+    bool tessellationSupported;
+    GrassGeometry grassGeometry = GrassGeometry::Tessellation;
+    bool grassGeometryChanged = false;
+
+    bool depthBinningSupported;
+    bool depthBinningChanged = false;
+
+    bool multiDrawIndirectSupported;
+
+    // GPU time of the grass draws, two timestamps per swap chain image
+    vk::QueryPool grassTimestampQueryPool;
+    std::vector<bool> grassTimestampsWritten;
+    uint64_t timestampMask = 0;
+    double grassTimeTotal = 0.0;
+    uint32_t grassTimeSamples = 0;
+
+    // Pipeline statistics of the ground (models and terrain) and grass draws, two queries per swap chain image.
+    // Totals hold statisticsCount counters for the ground followed by the same counters for the grass.
+    vk::QueryPool statisticsQueryPool;
+    uint32_t statisticsCount = 0;
+    std::vector<uint64_t> statisticsTotals;
+
+    ShaderWatcher* shaderWatcher = nullptr;
+
+    // Pipelines rebuilt by the shader watcher, swapped in at the start of the next frame
+    std::mutex reloadMutex;
+    std::vector<std::pair<vk::Pipeline*, vk::Pipeline>> reloadedPipelines;
 };
@@ -17,6 +17,10 @@ const std::vector<Blades*>& Scene::GetBlades() const {
     return blades;
 }
 
+Terrain* Scene::GetTerrain() const {
+    return terrain;
+}
+
 void Scene::AddModel(Model* model) {
     models.push_back(model);
 }
@@ -25,6 +29,10 @@ void Scene::AddBlades(Blades* blades) {
     this->blades.push_back(blades);
 }
 
+void Scene::SetTerrain(Terrain* terrain) {
+    this->terrain = terrain;
+}
+
 void Scene::UpdateTime() {
     high_resolution_clock::time_point currentTime = high_resolution_clock::now();
     duration<float> nextDeltaTime = duration_cast<duration<float>>(currentTime - startTime);
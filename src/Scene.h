@@ -3,6 +3,7 @@
 #include <chrono>
 #include "Model.h"
 #include "Blades.h"
+#include "Terrain.h"
 
 using namespace std::chrono;
 
@@ -22,6 +23,8 @@ private:
 
     std::vector<Model*> models;
     std::vector<Blades*> blades;
+    // Drawn with its own pipeline rather than with the models, may be null
+    Terrain* terrain = nullptr;
 
     high_resolution_clock::time_point startTime = high_resolution_clock::now();
 
@@ -32,9 +35,11 @@ public:
 
     const std::vector<Model*>& GetModels() const;
     const std::vector<Blades*>& GetBlades() const;
+    Terrain* GetTerrain() const;
     
     void AddModel(Model* model);
     void AddBlades(Blades* blades);
+    void SetTerrain(Terrain* terrain);
 
     vk::Buffer GetTimeBuffer() const;
 
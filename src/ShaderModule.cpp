@@ -22,6 +22,12 @@ namespace {
 
 // Wrap the shaders in shader modules
 vk::ShaderModule ShaderModule::Create(const std::vector<char>& code, vk::Device logicalDevice) {
+    // Reject truncated or non-SPIR-V files (e.g. a binary caught mid-write by a hot reload) before they reach the driver
+    const uint32_t SPIRV_MAGIC = 0x07230203;
+    if (code.size() < sizeof(uint32_t) || code.size() % sizeof(uint32_t) != 0 || *reinterpret_cast<const uint32_t*>(code.data()) != SPIRV_MAGIC) {
+        throw std::runtime_error("Invalid SPIR-V shader code");
+    }
+
     vk::ShaderModuleCreateInfo createInfo;
     createInfo.setCodeSize(code.size());
     createInfo.setPCode(reinterpret_cast<const uint32_t*>(code.data()));
@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include "ShaderWatcher.h"
+
+namespace {
+    // 64-bit FNV-1a of the file contents, or 0 if the file can't be read
+    uint64_t hashFile(const std::string& filename) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            return 0;
+        }
+
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (std::istreambuf_iterator<char> it(file), end; it != end; ++it) {
+            hash ^= static_cast<uint8_t>(*it);
+            hash *= 0x100000001b3ull;
+        }
+
+        return hash;
+    }
+}
+
+ShaderWatcher::ShaderWatcher(std::chrono::milliseconds interval)
+    : interval(interval) {
+}
+
+void ShaderWatcher::Watch(const std::vector<std::string>& files, Callback onChange) {
+    Group group;
+    group.files = files;
+    group.onChange = onChange;
+    for (const std::string& file : files) {
+        group.hashes.push_back(hashFile(file));
+    }
+
+    groups.push_back(group);
+}
+
+void ShaderWatcher::Start() {
+    running = true;
+    thread = std::thread(&ShaderWatcher::Poll, this);
+}
+
+void ShaderWatcher::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    stopCondition.notify_all();
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void ShaderWatcher::Poll() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopCondition.wait_for(lock, interval, [this]() { return !running; })) {
+        for (Group& group : groups) {
+            bool changed = false;
+            for (size_t i = 0; i < group.files.size(); i++) {
+                uint64_t hash = hashFile(group.files[i]);
+
+                // Skip files that are missing mid-write; they'll be picked up on a later poll
+                if (hash != 0 && hash != group.hashes[i]) {
+                    group.hashes[i] = hash;
+                    changed = true;
+                }
+            }
+
+            if (changed) {
+                printf("Reloading %s\n", group.files[0].c_str());
+                group.onChange();
+            }
+        }
+    }
+}
+
+ShaderWatcher::~ShaderWatcher() {
+    Stop();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef SHADER_HOT_RELOAD
+static constexpr bool ENABLE_SHADER_HOT_RELOAD = true;
+#else
+static constexpr bool ENABLE_SHADER_HOT_RELOAD = false;
+#endif
+
+// Polls groups of shader binaries on a background thread and runs a callback (on that thread)
+// whenever the contents of any file in a group change
+class ShaderWatcher {
+public:
+    using Callback = std::function<void()>;
+
+    ShaderWatcher() = delete;
+    ShaderWatcher(std::chrono::milliseconds interval);
+    ~ShaderWatcher();
+
+    // Must be called before Start()
+    void Watch(const std::vector<std::string>& files, Callback onChange);
+
+    void Start();
+    void Stop();
+
+private:
+    struct Group {
+        std::vector<std::string> files;
+        std::vector<uint64_t> hashes;
+        Callback onChange;
+    };
+
+    void Poll();
+
+    std::chrono::milliseconds interval;
+    std::vector<Group> groups;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable stopCondition;
+    bool running = false;
+};
@@ -0,0 +1,256 @@
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+#include "Terrain.h"
+#include "BufferUtils.h"
+#include "Image.h"
+
+namespace {
+    constexpr vk::Format MAP_FORMAT = vk::Format::eR16G16B16A16Sfloat;
+    constexpr vk::Format GRASS_MAP_FORMAT = vk::Format::eR8G8B8A8Unorm;
+
+    // Random value in [0, 1] at a lattice point, wrapping every period points so the map tiles
+    float latticeValue(int x, int z, int period) {
+        uint32_t wrappedX = static_cast<uint32_t>(((x % period) + period) % period);
+        uint32_t wrappedZ = static_cast<uint32_t>(((z % period) + period) % period);
+        uint32_t hash = (wrappedX * 73856093u) ^ (wrappedZ * 19349663u) ^ (static_cast<uint32_t>(period) * 83492791u);
+        hash ^= hash >> 13;
+        hash *= 0x5bd1e995u;
+        hash ^= hash >> 15;
+        return (hash & 0xffffu) / 65535.0f;
+    }
+
+    // Smoothly interpolated value noise, p in lattice units
+    float valueNoise(glm::vec2 p, int period) {
+        glm::vec2 base = glm::floor(p);
+        glm::vec2 f = p - base;
+        glm::vec2 s = f * f * (3.0f - 2.0f * f);
+        int x = static_cast<int>(base.x);
+        int z = static_cast<int>(base.y);
+        float bottom = glm::mix(latticeValue(x, z, period), latticeValue(x + 1, z, period), s.x);
+        float top = glm::mix(latticeValue(x, z + 1, period), latticeValue(x + 1, z + 1, period), s.x);
+        return glm::mix(bottom, top, s.y);
+    }
+}
+
+Terrain::Terrain(Device* device, vk::CommandPool commandPool, float size, uint32_t resolution, float textureSize)
+    : Model(device, commandPool, BuildGridVertices(size, resolution, textureSize), BuildGridIndices(resolution))
+{
+    GenerateMap();
+
+    std::vector<uint64_t> texels(map.size());
+    for (size_t i = 0; i < map.size(); i++) {
+        texels[i] = glm::packHalf4x16(map[i]);
+    }
+    CreateImage(commandPool, texels.data(), texels.size() * sizeof(uint64_t), MAP_FORMAT, mapImage, mapImageMemory);
+    mapView = Image::CreateView(device, mapImage, MAP_FORMAT, vk::ImageAspectFlagBits::eColor);
+
+    std::vector<uint32_t> grassMap = GenerateGrassMap();
+    CreateImage(commandPool, grassMap.data(), grassMap.size() * sizeof(uint32_t), GRASS_MAP_FORMAT, grassMapImage, grassMapImageMemory);
+    grassMapView = Image::CreateView(device, grassMapImage, GRASS_MAP_FORMAT, vk::ImageAspectFlagBits::eColor);
+
+    CreateMapSampler();
+}
+
+std::vector<Vertex> Terrain::BuildGridVertices(float size, uint32_t resolution, float textureSize) {
+    std::vector<Vertex> vertices;
+    vertices.reserve((resolution + 1) * (resolution + 1));
+
+    for (uint32_t z = 0; z <= resolution; z++) {
+        for (uint32_t x = 0; x <= resolution; x++) {
+            glm::vec2 local = (glm::vec2(x, z) / static_cast<float>(resolution) - 0.5f) * size;
+
+            // Heights are applied in terrain.vert
+            Vertex vertex;
+            vertex.pos = glm::vec3(local.x, 0.0f, local.y);
+            vertex.color = glm::vec3(1.0f);
+            vertex.texCoord = (local + 0.5f * size) / textureSize;
+            vertices.push_back(vertex);
+        }
+    }
+
+    return vertices;
+}
+
+std::vector<uint32_t> Terrain::BuildGridIndices(uint32_t resolution) {
+    std::vector<uint32_t> indices;
+    indices.reserve(6 * resolution * resolution);
+
+    uint32_t rowLength = resolution + 1;
+    for (uint32_t z = 0; z < resolution; z++) {
+        for (uint32_t x = 0; x < resolution; x++) {
+            uint32_t corner = z * rowLength + x;
+            indices.insert(indices.end(), { corner, corner + rowLength, corner + 1, corner + 1, corner + rowLength, corner + rowLength + 1 });
+        }
+    }
+
+    return indices;
+}
+
+void Terrain::GenerateMap() {
+    // A few octaves of value noise, each wrapping a whole number of times across the map
+    const int periods[] = { 3, 6, 12, 24 };
+    const float amplitudes[] = { 1.0f, 0.5f, 0.25f, 0.125f };
+    const float amplitudeSum = 1.875f;
+
+    std::vector<float> heights(TERRAIN_MAP_DIM * TERRAIN_MAP_DIM);
+    for (uint32_t z = 0; z < TERRAIN_MAP_DIM; z++) {
+        for (uint32_t x = 0; x < TERRAIN_MAP_DIM; x++) {
+            glm::vec2 uv = glm::vec2(x, z) / static_cast<float>(TERRAIN_MAP_DIM);
+            float noise = 0.0f;
+            for (int octave = 0; octave < 4; octave++) {
+                noise += amplitudes[octave] * valueNoise(uv * static_cast<float>(periods[octave]), periods[octave]);
+            }
+            heights[z * TERRAIN_MAP_DIM + x] = (noise / amplitudeSum - 0.5f) * TERRAIN_HEIGHT;
+        }
+    }
+
+    // Normals from central differences, wrapping at the edges like the heights do
+    auto heightAt = [&heights](int x, int z) {
+        int dim = static_cast<int>(TERRAIN_MAP_DIM);
+        return heights[((z + dim) % dim) * dim + (x + dim) % dim];
+    };
+    float texelSize = TERRAIN_MAP_SIZE / TERRAIN_MAP_DIM;
+
+    map.resize(TERRAIN_MAP_DIM * TERRAIN_MAP_DIM);
+    for (int z = 0; z < static_cast<int>(TERRAIN_MAP_DIM); z++) {
+        for (int x = 0; x < static_cast<int>(TERRAIN_MAP_DIM); x++) {
+            float dx = (heightAt(x + 1, z) - heightAt(x - 1, z)) / (2.0f * texelSize);
+            float dz = (heightAt(x, z + 1) - heightAt(x, z - 1)) / (2.0f * texelSize);
+            glm::vec3 normal = glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+
+            // Keep what the GPU will see, so blades placed on the CPU sit exactly on the rendered surface
+            map[z * TERRAIN_MAP_DIM + x] = glm::unpackHalf4x16(glm::packHalf4x16(glm::vec4(normal, heightAt(x, z))));
+        }
+    }
+}
+
+std::vector<uint32_t> Terrain::GenerateGrassMap() const {
+    std::vector<uint32_t> texels(TERRAIN_MAP_DIM * TERRAIN_MAP_DIM);
+
+    for (uint32_t z = 0; z < TERRAIN_MAP_DIM; z++) {
+        for (uint32_t x = 0; x < TERRAIN_MAP_DIM; x++) {
+            const glm::vec4& texel = map[z * TERRAIN_MAP_DIM + x];
+            glm::vec2 uv = glm::vec2(x, z) / static_cast<float>(TERRAIN_MAP_DIM);
+
+            // Bare clearings scattered over the map, and thinner grass on steep slopes
+            float clearing = valueNoise(uv * 10.0f, 10);
+            float density = glm::smoothstep(0.25f, 0.45f, clearing) * glm::smoothstep(0.8f, 0.95f, texel.y);
+
+            uint32_t region = TERRAIN_REGION_MEADOW;
+            if (texel.w > 0.25f * TERRAIN_HEIGHT) {
+                region = TERRAIN_REGION_HILLTOP;
+            }
+            else if (texel.w < -0.25f * TERRAIN_HEIGHT) {
+                region = TERRAIN_REGION_HOLLOW;
+            }
+
+            uint32_t red = static_cast<uint32_t>(density * 255.0f + 0.5f);
+            texels[z * TERRAIN_MAP_DIM + x] = red | (region << 8) | (0xffu << 24);
+        }
+    }
+
+    return texels;
+}
+
+void Terrain::CreateImage(vk::CommandPool commandPool, const void* data, vk::DeviceSize size, vk::Format format, vk::Image& image, vk::DeviceMemory& imageMemory) {
+    vk::Buffer stagingBuffer;
+    vk::DeviceMemory stagingBufferMemory;
+    BufferUtils::CreateBuffer(device, size, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, stagingBuffer, stagingBufferMemory);
+
+    void* mappedData = device->GetLogicalDevice().mapMemory(stagingBufferMemory, 0, size);
+    memcpy(mappedData, data, static_cast<size_t>(size));
+    device->GetLogicalDevice().unmapMemory(stagingBufferMemory);
+
+    Image::Create(device, TERRAIN_MAP_DIM, TERRAIN_MAP_DIM, format, vk::ImageTiling::eOptimal,
+        vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, vk::MemoryPropertyFlagBits::eDeviceLocal, image, imageMemory);
+    Image::TransitionLayout(device, commandPool, image, format, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+    Image::CopyFromBuffer(device, commandPool, stagingBuffer, image, TERRAIN_MAP_DIM, TERRAIN_MAP_DIM);
+    Image::TransitionLayout(device, commandPool, image, format, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+    device->GetLogicalDevice().destroyBuffer(stagingBuffer);
+    device->GetLogicalDevice().freeMemory(stagingBufferMemory);
+}
+
+void Terrain::LoadGrassMap(vk::CommandPool commandPool, const char* path) {
+    device->GetLogicalDevice().destroyImageView(grassMapView);
+    device->GetLogicalDevice().destroyImage(grassMapImage);
+    device->GetLogicalDevice().freeMemory(grassMapImageMemory);
+
+    Image::FromFile(device, commandPool, path, GRASS_MAP_FORMAT, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eSampled,
+        vk::ImageLayout::eShaderReadOnlyOptimal, vk::MemoryPropertyFlagBits::eDeviceLocal, grassMapImage, grassMapImageMemory);
+    grassMapView = Image::CreateView(device, grassMapImage, GRASS_MAP_FORMAT, vk::ImageAspectFlagBits::eColor);
+}
+
+void Terrain::CreateMapSampler() {
+    // Repeat so the maps tile the world, linear so the displaced grid stays smooth between texels
+    vk::SamplerCreateInfo samplerInfo;
+    samplerInfo.setMagFilter(vk::Filter::eLinear);
+    samplerInfo.setMinFilter(vk::Filter::eLinear);
+    samplerInfo.setAddressModeU(vk::SamplerAddressMode::eRepeat);
+    samplerInfo.setAddressModeV(vk::SamplerAddressMode::eRepeat);
+    samplerInfo.setAddressModeW(vk::SamplerAddressMode::eRepeat);
+    samplerInfo.setAnisotropyEnable(VK_FALSE);
+    samplerInfo.setMaxAnisotropy(1);
+    samplerInfo.setBorderColor(vk::BorderColor::eIntOpaqueBlack);
+    samplerInfo.setUnnormalizedCoordinates(VK_FALSE);
+    samplerInfo.setCompareEnable(VK_FALSE);
+    samplerInfo.setCompareOp(vk::CompareOp::eAlways);
+    samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+    samplerInfo.setMipLodBias(0.0f);
+    samplerInfo.setMinLod(0.0f);
+    samplerInfo.setMaxLod(0.0f);
+
+    try {
+        mapSampler = device->GetLogicalDevice().createSampler(samplerInfo);
+    }
+    catch (vk::SystemError err) {
+        throw std::runtime_error("Failed to create terrain map sampler");
+    }
+}
+
+glm::vec4 Terrain::Sample(glm::vec2 xz) const {
+    // Texel centers sit at half-texel offsets, as in the sampler
+    glm::vec2 texel = xz / TERRAIN_MAP_SIZE * static_cast<float>(TERRAIN_MAP_DIM) - 0.5f;
+    glm::vec2 base = glm::floor(texel);
+    glm::vec2 f = texel - base;
+
+    auto at = [this](int x, int z) {
+        int dim = static_cast<int>(TERRAIN_MAP_DIM);
+        return map[((z % dim + dim) % dim) * dim + (x % dim + dim) % dim];
+    };
+    int x = static_cast<int>(base.x);
+    int z = static_cast<int>(base.y);
+    glm::vec4 bottom = glm::mix(at(x, z), at(x + 1, z), f.x);
+    glm::vec4 top = glm::mix(at(x, z + 1), at(x + 1, z + 1), f.x);
+    return glm::mix(bottom, top, f.y);
+}
+
+float Terrain::GetHeight(glm::vec2 xz) const {
+    return Sample(xz).w;
+}
+
+glm::vec3 Terrain::GetNormal(glm::vec2 xz) const {
+    return glm::normalize(glm::vec3(Sample(xz)));
+}
+
+vk::ImageView Terrain::GetMapView() const {
+    return mapView;
+}
+
+vk::ImageView Terrain::GetGrassMapView() const {
+    return grassMapView;
+}
+
+vk::Sampler Terrain::GetMapSampler() const {
+    return mapSampler;
+}
+
+Terrain::~Terrain() {
+    device->GetLogicalDevice().destroySampler(mapSampler);
+    device->GetLogicalDevice().destroyImageView(grassMapView);
+    device->GetLogicalDevice().destroyImage(grassMapImage);
+    device->GetLogicalDevice().freeMemory(grassMapImageMemory);
+    device->GetLogicalDevice().destroyImageView(mapView);
+    device->GetLogicalDevice().destroyImage(mapImage);
+    device->GetLogicalDevice().freeMemory(mapImageMemory);
+}
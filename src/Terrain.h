@@ -0,0 +1,64 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Model.h"
+
+// The height and normal map covers TERRAIN_MAP_SIZE x TERRAIN_MAP_SIZE meters and repeats beyond that.
+// Matches shaders/terrain.glsl.
+constexpr static unsigned int TERRAIN_MAP_DIM = 256;
+constexpr static float TERRAIN_MAP_SIZE = 120.0f;
+// Height between the lowest trough and the highest hill, centered on y = 0
+constexpr static float TERRAIN_HEIGHT = 3.0f;
+
+// Regions of the generated grass map, each with its own blade ranges in BladeGenerator
+enum TerrainRegion : uint32_t {
+    TERRAIN_REGION_MEADOW = 0,
+    TERRAIN_REGION_HILLTOP,  // short, stiff grass
+    TERRAIN_REGION_HOLLOW,   // tall, soft grass
+};
+
+// Rolling hills under the grass. A tileable height and normal map is generated once, kept on the CPU for placing
+// blades and uploaded as a texture that terrain.vert displaces a flat grid with. Heights are looked up in world
+// space, so the grid can be moved freely, e.g. to follow the streamed grass.
+// A grass map over the same area holds the blade density in red and the region index in green.
+class Terrain : public Model {
+private:
+    // Normal in xyz and height in w, rounded to the half floats the GPU samples
+    std::vector<glm::vec4> map;
+
+    vk::Image mapImage;
+    vk::DeviceMemory mapImageMemory;
+    vk::ImageView mapView;
+    vk::Sampler mapSampler;
+
+    vk::Image grassMapImage;
+    vk::DeviceMemory grassMapImageMemory;
+    vk::ImageView grassMapView;
+
+    static std::vector<Vertex> BuildGridVertices(float size, uint32_t resolution, float textureSize);
+    static std::vector<uint32_t> BuildGridIndices(uint32_t resolution);
+
+    void GenerateMap();
+    std::vector<uint32_t> GenerateGrassMap() const;
+    void CreateImage(vk::CommandPool commandPool, const void* data, vk::DeviceSize size, vk::Format format, vk::Image& image, vk::DeviceMemory& imageMemory);
+    void CreateMapSampler();
+    glm::vec4 Sample(glm::vec2 xz) const;
+
+public:
+    // A flat size x size grid of resolution x resolution quads centered on the origin, textured once every textureSize meters
+    Terrain(Device* device, vk::CommandPool commandPool, float size, uint32_t resolution, float textureSize);
+    ~Terrain();
+
+    // Bilinear lookups that match the GPU's filtering of the map. Read-only, so they can run on any thread.
+    float GetHeight(glm::vec2 xz) const;
+    glm::vec3 GetNormal(glm::vec2 xz) const;
+
+    // Replaces the generated grass map with a painted one. It covers the same area as the height map at any resolution.
+    void LoadGrassMap(vk::CommandPool commandPool, const char* path);
+
+    vk::ImageView GetMapView() const;
+    vk::ImageView GetGrassMapView() const;
+    // Repeating and linear, for both maps
+    vk::Sampler GetMapSampler() const;
+};
@@ -0,0 +1,365 @@
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+#include <stb_image.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "TextureCache.h"
+#include "Image.h"
+#include "BufferUtils.h"
+
+namespace {
+    // KTX 1.1 container, see https://registry.khronos.org/KTX/specs/1.0/ktxspec.v1.html
+    const uint8_t KTX_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+    constexpr uint32_t KTX_ENDIANNESS = 0x04030201;
+    constexpr uint32_t KTX_COMPRESSED_RGB_S3TC_DXT1 = 0x83F0;
+    constexpr uint32_t KTX_RGB = 0x1907;
+
+    // Key/value entry holding the size and modification time of the source image the cache was built from
+    const std::string SOURCE_STAMP_KEY = "GrassSourceStamp";
+
+    constexpr uint32_t BLOCK_DIM = 4;
+    constexpr uint32_t BLOCK_BYTES = 8;
+
+    struct KtxHeader {
+        uint8_t identifier[12];
+        uint32_t endianness;
+        uint32_t glType;
+        uint32_t glTypeSize;
+        uint32_t glFormat;
+        uint32_t glInternalFormat;
+        uint32_t glBaseInternalFormat;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t numberOfArrayElements;
+        uint32_t numberOfFaces;
+        uint32_t numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    };
+
+    struct CompressedMip {
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> data;
+    };
+
+    uint32_t getCompressedSize(uint32_t width, uint32_t height) {
+        return ((width + BLOCK_DIM - 1) / BLOCK_DIM) * ((height + BLOCK_DIM - 1) / BLOCK_DIM) * BLOCK_BYTES;
+    }
+
+    std::vector<char> readFile(const std::string& filename) {
+        std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+        if (!file.is_open()) {
+            return {};
+        }
+
+        size_t fileSize = (size_t)file.tellg();
+        std::vector<char> buffer(fileSize);
+
+        file.seekg(0);
+        file.read(buffer.data(), fileSize);
+
+        file.close();
+        return buffer;
+    }
+
+    // Size and modification time of the source file, so a cache hit never has to read the source itself
+    std::string stampSource(const char* path) {
+        struct stat info;
+        if (stat(path, &info) != 0) {
+            return std::string();
+        }
+
+        char stamp[34];
+        snprintf(stamp, sizeof(stamp), "%016llx%016llx", static_cast<unsigned long long>(info.st_size), static_cast<unsigned long long>(info.st_mtime));
+        return std::string(stamp);
+    }
+
+    // 2x2 box filter, clamping at odd edges
+    std::vector<uint8_t> downsample(const std::vector<uint8_t>& src, uint32_t width, uint32_t height, uint32_t& outWidth, uint32_t& outHeight) {
+        outWidth = std::max(1u, width / 2);
+        outHeight = std::max(1u, height / 2);
+
+        std::vector<uint8_t> dst(outWidth * outHeight * 4);
+        for (uint32_t y = 0; y < outHeight; y++) {
+            uint32_t y0 = std::min(2 * y, height - 1);
+            uint32_t y1 = std::min(2 * y + 1, height - 1);
+            for (uint32_t x = 0; x < outWidth; x++) {
+                uint32_t x0 = std::min(2 * x, width - 1);
+                uint32_t x1 = std::min(2 * x + 1, width - 1);
+                for (uint32_t c = 0; c < 4; c++) {
+                    uint32_t sum = src[(y0 * width + x0) * 4 + c] + src[(y0 * width + x1) * 4 + c] +
+                                   src[(y1 * width + x0) * 4 + c] + src[(y1 * width + x1) * 4 + c];
+                    dst[(y * outWidth + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+
+        return dst;
+    }
+
+    std::vector<uint8_t> compressBC1(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height) {
+        uint32_t blocksX = (width + BLOCK_DIM - 1) / BLOCK_DIM;
+        uint32_t blocksY = (height + BLOCK_DIM - 1) / BLOCK_DIM;
+        std::vector<uint8_t> compressed(blocksX * blocksY * BLOCK_BYTES);
+
+        uint8_t block[BLOCK_DIM * BLOCK_DIM * 4];
+        for (uint32_t by = 0; by < blocksY; by++) {
+            for (uint32_t bx = 0; bx < blocksX; bx++) {
+                // Gather the 4x4 texels of this block, replicating edge texels for partial blocks
+                for (uint32_t y = 0; y < BLOCK_DIM; y++) {
+                    uint32_t sy = std::min(by * BLOCK_DIM + y, height - 1);
+                    for (uint32_t x = 0; x < BLOCK_DIM; x++) {
+                        uint32_t sx = std::min(bx * BLOCK_DIM + x, width - 1);
+                        memcpy(&block[(y * BLOCK_DIM + x) * 4], &rgba[(sy * width + sx) * 4], 4);
+                    }
+                }
+
+                stb_compress_dxt_block(&compressed[(by * blocksX + bx) * BLOCK_BYTES], block, 0, STB_DXT_HIGHQUAL);
+            }
+        }
+
+        return compressed;
+    }
+
+    std::vector<CompressedMip> buildMips(const std::vector<char>& source) {
+        int texWidth, texHeight, texChannels;
+        stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.data()), static_cast<int>(source.size()), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+        if (!pixels) {
+            throw std::runtime_error("Failed to load texture image");
+        }
+
+        uint32_t width = static_cast<uint32_t>(texWidth);
+        uint32_t height = static_cast<uint32_t>(texHeight);
+        std::vector<uint8_t> level(pixels, pixels + width * height * 4);
+        stbi_image_free(pixels);
+
+        std::vector<CompressedMip> mips;
+        while (true) {
+            mips.push_back({ width, height, compressBC1(level, width, height) });
+
+            if (width == 1 && height == 1) {
+                break;
+            }
+
+            uint32_t nextWidth, nextHeight;
+            level = downsample(level, width, height, nextWidth, nextHeight);
+            width = nextWidth;
+            height = nextHeight;
+        }
+
+        return mips;
+    }
+
+    bool readCache(const std::string& cachePath, const std::string& sourceStamp, std::vector<CompressedMip>& mips) {
+        std::ifstream file(cachePath, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        // Sizes read from the file are checked against what is left of it, so a corrupt cache is rebuilt
+        // rather than allocating whatever it claims
+        size_t fileSize = (size_t)file.tellg();
+        file.seekg(0);
+
+        KtxHeader header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(KtxHeader)) ||
+            memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0 ||
+            header.endianness != KTX_ENDIANNESS ||
+            header.glInternalFormat != KTX_COMPRESSED_RGB_S3TC_DXT1 ||
+            header.numberOfFaces != 1 ||
+            header.numberOfMipmapLevels == 0) {
+            return false;
+        }
+
+        if (header.bytesOfKeyValueData > fileSize - sizeof(KtxHeader)) {
+            return false;
+        }
+
+        // The cache is stale unless it records the stamp of the current source image
+        std::vector<char> keyValueData(header.bytesOfKeyValueData);
+        if (!file.read(keyValueData.data(), keyValueData.size())) {
+            return false;
+        }
+
+        bool stampMatches = false;
+        size_t offset = 0;
+        while (offset + sizeof(uint32_t) <= keyValueData.size()) {
+            uint32_t keyAndValueByteSize;
+            memcpy(&keyAndValueByteSize, &keyValueData[offset], sizeof(uint32_t));
+            offset += sizeof(uint32_t);
+            if (offset + keyAndValueByteSize > keyValueData.size()) {
+                return false;
+            }
+
+            std::string entry(&keyValueData[offset], keyAndValueByteSize);
+            size_t separator = entry.find('\0');
+            if (separator != std::string::npos && entry.substr(0, separator) == SOURCE_STAMP_KEY) {
+                stampMatches = entry.compare(separator + 1, std::string::npos, sourceStamp + '\0') == 0;
+            }
+
+            offset += (keyAndValueByteSize + 3) & ~3u;
+        }
+
+        if (!stampMatches) {
+            return false;
+        }
+
+        uint32_t width = header.pixelWidth;
+        uint32_t height = header.pixelHeight;
+        mips.clear();
+        for (uint32_t i = 0; i < header.numberOfMipmapLevels; i++) {
+            uint32_t imageSize;
+            if (!file.read(reinterpret_cast<char*>(&imageSize), sizeof(uint32_t)) || imageSize != getCompressedSize(width, height) ||
+                imageSize > fileSize - static_cast<size_t>(file.tellg())) {
+                return false;
+            }
+
+            CompressedMip mip = { width, height, std::vector<uint8_t>(imageSize) };
+            if (!file.read(reinterpret_cast<char*>(mip.data.data()), imageSize)) {
+                return false;
+            }
+            mips.push_back(std::move(mip));
+
+            width = std::max(1u, width / 2);
+            height = std::max(1u, height / 2);
+        }
+
+        return true;
+    }
+
+    bool writeCache(const std::string& cachePath, const std::string& sourceStamp, const std::vector<CompressedMip>& mips) {
+        std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        std::vector<char> keyValue(SOURCE_STAMP_KEY.begin(), SOURCE_STAMP_KEY.end());
+        keyValue.push_back('\0');
+        keyValue.insert(keyValue.end(), sourceStamp.begin(), sourceStamp.end());
+        keyValue.push_back('\0');
+        uint32_t keyAndValueByteSize = static_cast<uint32_t>(keyValue.size());
+        uint32_t keyValuePadding = (4 - keyAndValueByteSize % 4) % 4;
+
+        KtxHeader header = {};
+        memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+        header.endianness = KTX_ENDIANNESS;
+        header.glTypeSize = 1;
+        header.glInternalFormat = KTX_COMPRESSED_RGB_S3TC_DXT1;
+        header.glBaseInternalFormat = KTX_RGB;
+        header.pixelWidth = mips[0].width;
+        header.pixelHeight = mips[0].height;
+        header.numberOfFaces = 1;
+        header.numberOfMipmapLevels = static_cast<uint32_t>(mips.size());
+        header.bytesOfKeyValueData = sizeof(uint32_t) + keyAndValueByteSize + keyValuePadding;
+
+        const char padding[4] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(KtxHeader));
+        file.write(reinterpret_cast<const char*>(&keyAndValueByteSize), sizeof(uint32_t));
+        file.write(keyValue.data(), keyValue.size());
+        file.write(padding, keyValuePadding);
+
+        // BC1 mip sizes are always a multiple of 8 bytes, so no mip padding is needed
+        for (const CompressedMip& mip : mips) {
+            uint32_t imageSize = static_cast<uint32_t>(mip.data.size());
+            file.write(reinterpret_cast<const char*>(&imageSize), sizeof(uint32_t));
+            file.write(reinterpret_cast<const char*>(mip.data.data()), imageSize);
+        }
+
+        return file.good();
+    }
+}
+
+bool TextureCache::IsSupported(vk::PhysicalDevice physicalDevice) {
+    vk::FormatProperties formatProperties = physicalDevice.getFormatProperties(FORMAT);
+    return physicalDevice.getFeatures().textureCompressionBC &&
+           (formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage);
+}
+
+std::string TextureCache::GetCachePath(const std::string& sourcePath) {
+    size_t separator = sourcePath.find_last_of("/\\");
+    size_t extension = sourcePath.find_last_of('.');
+    if (extension == std::string::npos || (separator != std::string::npos && extension < separator)) {
+        return sourcePath + ".ktx";
+    }
+
+    return sourcePath.substr(0, extension) + ".ktx";
+}
+
+void TextureCache::FromFile(Device* device, vk::CommandPool commandPool, const char* path, vk::ImageUsageFlags usage, vk::ImageLayout layout, vk::MemoryPropertyFlags properties, vk::Image& image, vk::DeviceMemory& imageMemory, uint32_t& mipLevels) {
+    std::string sourceStamp = stampSource(path);
+    if (sourceStamp.empty()) {
+        throw std::runtime_error("Failed to load texture image");
+    }
+
+    // Only a stat of the source happens on a cache hit; reading, decoding and compression are skipped
+    std::string cachePath = GetCachePath(path);
+
+    std::vector<CompressedMip> mips;
+    if (!readCache(cachePath, sourceStamp, mips)) {
+        std::vector<char> source = readFile(path);
+        if (source.empty()) {
+            throw std::runtime_error("Failed to load texture image");
+        }
+
+        mips = buildMips(source);
+
+        if (!writeCache(cachePath, sourceStamp, mips)) {
+            fprintf(stderr, "Failed to write texture cache %s\n", cachePath.c_str());
+        }
+    }
+
+    mipLevels = static_cast<uint32_t>(mips.size());
+
+    // Pack every mip level into one staging buffer
+    vk::DeviceSize imageSize = 0;
+    std::vector<vk::BufferImageCopy> regions(mipLevels);
+    for (uint32_t i = 0; i < mipLevels; i++) {
+        regions[i].setBufferOffset(imageSize);
+        regions[i].setBufferRowLength(0);
+        regions[i].setBufferImageHeight(0);
+
+        regions[i].imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        regions[i].imageSubresource.mipLevel = i;
+        regions[i].imageSubresource.baseArrayLayer = 0;
+        regions[i].imageSubresource.layerCount = 1;
+
+        regions[i].setImageOffset(vk::Offset3D{ 0, 0, 0 });
+        regions[i].setImageExtent(vk::Extent3D{ mips[i].width, mips[i].height, 1 });
+
+        imageSize += mips[i].data.size();
+    }
+
+    // Create staging buffer
+    vk::Buffer stagingBuffer;
+    vk::DeviceMemory stagingBufferMemory;
+
+    vk::BufferUsageFlags stagingUsage(vk::BufferUsageFlagBits::eTransferSrc);
+    vk::MemoryPropertyFlags stagingProperties(vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    BufferUtils::CreateBuffer(device, imageSize, stagingUsage, stagingProperties, stagingBuffer, stagingBufferMemory);
+
+    char* data = static_cast<char*>(device->GetLogicalDevice().mapMemory(stagingBufferMemory, 0, imageSize));
+    for (uint32_t i = 0; i < mipLevels; i++) {
+        memcpy(data + regions[i].bufferOffset, mips[i].data.data(), mips[i].data.size());
+    }
+    device->GetLogicalDevice().unmapMemory(stagingBufferMemory);
+
+    // Create Vulkan image with the full mip chain and upload every level at once
+    Image::Create(device, mips[0].width, mips[0].height, mipLevels, FORMAT, vk::ImageTiling::eOptimal, vk::ImageUsageFlags(vk::ImageUsageFlagBits::eTransferDst) | usage, properties, image, imageMemory);
+
+    Image::TransitionLayout(device, commandPool, image, FORMAT, mipLevels, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+    Image::CopyFromBuffer(device, commandPool, stagingBuffer, image, regions);
+    Image::TransitionLayout(device, commandPool, image, FORMAT, mipLevels, vk::ImageLayout::eTransferDstOptimal, layout);
+
+    // No need for staging buffer anymore
+    device->GetLogicalDevice().destroyBuffer(stagingBuffer);
+    device->GetLogicalDevice().freeMemory(stagingBufferMemory);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <string>
+#include "Device.h"
+
+// Block-compressed (BC1), pre-mipmapped texture cache.
+// The first time a source image is requested it is decoded, mipmapped and compressed on the CPU,
+// then written next to the source as a KTX file. Subsequent launches upload the cached mip chain directly.
+// BC1 is 8x smaller than R8G8B8A8 per level; the mip chain adds a third on top, so the whole texture
+// takes about 1/6 of the uncompressed, unmipmapped image.
+// The cache is keyed on the source's size and modification time, so a hit never reads the source.
+namespace TextureCache {
+    static constexpr vk::Format FORMAT = vk::Format::eBc1RgbUnormBlock;
+
+    // Whether the physical device can sample the cached format
+    bool IsSupported(vk::PhysicalDevice physicalDevice);
+
+    // Path of the cache file that belongs to a source image ("images/grass.jpg" -> "images/grass.ktx")
+    std::string GetCachePath(const std::string& sourcePath);
+
+    void FromFile(Device* device, vk::CommandPool commandPool, const char* path, vk::ImageUsageFlags usage, vk::ImageLayout layout, vk::MemoryPropertyFlags properties, vk::Image& image, vk::DeviceMemory& imageMemory, uint32_t& mipLevels);
+}
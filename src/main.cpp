@@ -1,10 +1,14 @@
+#include <fstream>
 #include <vulkan/vulkan.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include "Instance.h"
 #include "Window.h"
 #include "Renderer.h"
 #include "Camera.h"
 #include "Scene.h"
 #include "Image.h"
+#include "TextureCache.h"
+#include "GrassStreamer.h"
 
 Device* device;
 SwapChain* swapChain;
@@ -45,6 +49,32 @@ namespace {
         }
     }
 
+    void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+        // T switches the near grass between tessellation and fixed strips, timings are printed for each
+        if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+            bool tessellated = renderer->GetGrassGeometry() == GrassGeometry::Tessellation;
+            renderer->SetGrassGeometry(tessellated ? GrassGeometry::Strips : GrassGeometry::Tessellation);
+        }
+        // B switches near/far depth binning of the culled blades on and off
+        if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+            renderer->SetDepthBinning(!renderer->GetDepthBinning());
+        }
+    }
+
+    // WASD moves the camera across the ground, in units per second
+    void pollMovement(GLFWwindow* window, float deltaTime) {
+        const float speed = 8.0f;
+        float forward = 0.0f, right = 0.0f;
+        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) forward += 1.0f;
+        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) forward -= 1.0f;
+        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) right += 1.0f;
+        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) right -= 1.0f;
+
+        if (forward != 0.0f || right != 0.0f) {
+            camera->Pan(forward * speed * deltaTime, right * speed * deltaTime);
+        }
+    }
+
     void mouseMoveCallback(GLFWwindow* window, double xPosition, double yPosition) {
         if (leftMouseDown) {
             double sensitivity = 0.5;
@@ -83,10 +113,19 @@ int main() {
     instance->PickPhysicalDevice({ VK_KHR_SWAPCHAIN_EXTENSION_NAME }, QueueFlagBit::GraphicsBit | QueueFlagBit::TransferBit | QueueFlagBit::ComputeBit | QueueFlagBit::PresentBit, surface);
 
     vk::PhysicalDeviceFeatures deviceFeatures;
-    deviceFeatures.setTessellationShader(VK_TRUE);
+    // Grass falls back to strips on devices without tessellation
+    deviceFeatures.setTessellationShader(instance->GetPhysicalDevice().getFeatures().tessellationShader);
+    // Optional: near/far depth bins of the grass draws, one draw call per grass tier, and pipeline statistics in the profiling output
+    deviceFeatures.setDrawIndirectFirstInstance(instance->GetPhysicalDevice().getFeatures().drawIndirectFirstInstance);
+    deviceFeatures.setMultiDrawIndirect(instance->GetPhysicalDevice().getFeatures().multiDrawIndirect);
+    deviceFeatures.setPipelineStatisticsQuery(instance->GetPhysicalDevice().getFeatures().pipelineStatisticsQuery);
     deviceFeatures.setFillModeNonSolid(VK_TRUE);
     deviceFeatures.setSamplerAnisotropy(VK_TRUE);
 
+    // Sample the grass texture from the block-compressed cache when the device supports it
+    bool useTextureCache = TextureCache::IsSupported(instance->GetPhysicalDevice());
+    deviceFeatures.setTextureCompressionBC(useTextureCache ? VK_TRUE : VK_FALSE);
+
     device = instance->CreateDevice(QueueFlagBit::GraphicsBit | QueueFlagBit::TransferBit | QueueFlagBit::ComputeBit | QueueFlagBit::PresentBit, deviceFeatures);
 
     swapChain = device->CreateSwapChain(surface, 5);
@@ -107,48 +146,82 @@ int main() {
 
     vk::Image grassImage;
     vk::DeviceMemory grassImageMemory;
-    Image::FromFile(device,
-        transferCommandPool,
-        "images/grass.jpg",
-        vk::Format::eR8G8B8A8Unorm,
-        vk::ImageTiling::eOptimal,
-        vk::ImageUsageFlags(vk::ImageUsageFlagBits::eSampled),
-        vk::ImageLayout::eShaderReadOnlyOptimal,
-        vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eDeviceLocal),
-        grassImage,
-        grassImageMemory
-    );
+    vk::Format grassImageFormat = vk::Format::eR8G8B8A8Unorm;
+    uint32_t grassImageMipLevels = 1;
+    if (useTextureCache) {
+        grassImageFormat = TextureCache::FORMAT;
+        TextureCache::FromFile(device,
+            transferCommandPool,
+            "images/grass.jpg",
+            vk::ImageUsageFlags(vk::ImageUsageFlagBits::eSampled),
+            vk::ImageLayout::eShaderReadOnlyOptimal,
+            vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eDeviceLocal),
+            grassImage,
+            grassImageMemory,
+            grassImageMipLevels
+        );
+    } else {
+        Image::FromFile(device,
+            transferCommandPool,
+            "images/grass.jpg",
+            grassImageFormat,
+            vk::ImageTiling::eOptimal,
+            vk::ImageUsageFlags(vk::ImageUsageFlagBits::eSampled),
+            vk::ImageLayout::eShaderReadOnlyOptimal,
+            vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eDeviceLocal),
+            grassImage,
+            grassImageMemory
+        );
+    }
 
 
+    // Grass is streamed in planeDim x planeDim chunks; a ring of 2 chunks reaches past the culling distance in every direction
     float planeDim = 15.f;
-    float halfWidth = planeDim * 0.5f;
-    Model* plane = new Model(device, transferCommandPool,
-        {
-            { { -halfWidth, 0.0f, halfWidth }, { 1.0f, 0.0f, 0.0f },{ 1.0f, 0.0f } },
-            { { halfWidth, 0.0f, halfWidth }, { 0.0f, 1.0f, 0.0f },{ 0.0f, 0.0f } },
-            { { halfWidth, 0.0f, -halfWidth }, { 0.0f, 0.0f, 1.0f },{ 0.0f, 1.0f } },
-            { { -halfWidth, 0.0f, -halfWidth }, { 1.0f, 1.0f, 1.0f },{ 1.0f, 1.0f } }
-        },
-        { 0, 1, 2, 2, 3, 0 }
-    );
-    plane->SetTexture(grassImage);
-    
-    Blades* blades = new Blades(device, transferCommandPool, planeDim);
+    int ringRadius = 2;
 
-    device->GetLogicalDevice().destroyCommandPool(transferCommandPool);
+    // The ground grid covers the whole ring and follows it, with a quad every half meter. Its heights come from the
+    // terrain map in world space and the texture repeats once per chunk, so the moves don't show.
+    int ringChunks = 2 * ringRadius + 1;
+    Terrain* terrain = new Terrain(device, transferCommandPool, planeDim * ringChunks, static_cast<uint32_t>(2.0f * planeDim) * ringChunks, planeDim);
+    terrain->SetTexture(grassImage, grassImageFormat, grassImageMipLevels);
+
+    // A painted grass map, if there is one, replaces the generated density and regions
+    if (std::ifstream("images/grass_map.png").good()) {
+        terrain->LoadGrassMap(transferCommandPool, "images/grass_map.png");
+    }
 
     Scene* scene = new Scene(device);
-    scene->AddModel(plane);
-    scene->AddBlades(blades);
+    scene->SetTerrain(terrain);
+
+    GrassStreamer* grassStreamer = new GrassStreamer(device, scene, planeDim, ringRadius);
+
+    // Grow the first ring before the renderer tunes its compute pass, so the tuning runs over real blades
+    grassStreamer->Update(camera->GetEye());
+    device->GetLogicalDevice().waitIdle();
+    glm::vec2 startCenter = grassStreamer->GetCenter();
+    terrain->SetModelMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(startCenter.x, 0.0f, startCenter.y)));
 
     renderer = new Renderer(device, swapChain, scene, camera);
 
     glfwSetWindowSizeCallback(GetGLFWWindow(), resizeCallback);
     glfwSetMouseButtonCallback(GetGLFWWindow(), mouseDownCallback);
     glfwSetCursorPosCallback(GetGLFWWindow(), mouseMoveCallback);
+    glfwSetKeyCallback(GetGLFWWindow(), keyCallback);
 
+    double previousTime = glfwGetTime();
     while (!ShouldQuit()) {
         glfwPollEvents();
+
+        double currentTime = glfwGetTime();
+        pollMovement(GetGLFWWindow(), static_cast<float>(currentTime - previousTime));
+        previousTime = currentTime;
+
+        if (grassStreamer->Update(camera->GetEye())) {
+            // The ground follows the ring; like the camera, its matrix is written straight into mapped memory
+            glm::vec2 center = grassStreamer->GetCenter();
+            terrain->SetModelMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(center.x, 0.0f, center.y)));
+        }
+
         scene->UpdateTime();
         renderer->Frame();
     }
@@ -157,9 +230,11 @@ int main() {
     device->GetLogicalDevice().destroyImage(grassImage);
     device->GetLogicalDevice().freeMemory(grassImageMemory);
     
+    device->GetLogicalDevice().destroyCommandPool(transferCommandPool);
+
     delete scene;
-    delete plane;
-    delete blades;
+    delete terrain;
+    delete grassStreamer;
     delete camera;
     delete renderer;
     delete swapChain;
@@ -0,0 +1,76 @@
+// Blade layouts, matching Blade, BladeState and CulledBlade in Blades.h. Positions relative to the root and the
+// per-blade attributes are halves, the up vector is folded onto a square and quantized.
+
+// What never changes about a simulated blade, 24 bytes. The root is split into floats so the struct packs
+// without std430 padding it to 32.
+struct Blade {
+    float v0[3];       // root
+    uint up;           // octahedral up vector, 16 bit snorm components
+    uvec2 attributes;  // halves: direction, width, stiffness coefficient, height
+};
+
+// What the simulation moves, 16 bytes. Awake blades derive the Bezier point from the guide every frame; its height
+// is stored so sleeping blades don't have to.
+struct BladeState {
+    uvec2 v2;          // halves: physical model guide relative to the root, wind direction it came to rest in or negative
+    float bend;        // height of the corrected Bezier point above the root along up, read while the blade sleeps
+    uint padding;
+};
+
+// A blade that survived culling, drawn as one instance. The vertex fetch decodes v1 and v2.
+struct CulledBlade {
+    vec3 v0;           // root
+    uint orientation;  // direction in the low 16 bits as unorm over a full turn, octahedral up vector in the high 16 as 8 bit snorm
+    uvec2 v1;          // halves: Bezier point relative to the root, packed tessellation levels
+    uvec2 v2;          // halves: physical model guide relative to the root, width
+};
+
+const float BLADE_TWO_PI = 6.28318531;
+
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Folds a unit vector onto the unit square around +y, where blades point, so near vertical vectors keep the most precision
+vec2 octEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xz;
+    return n.y < 0.0 ? (1.0 - abs(e.yx)) * signNotZero(e) : e;
+}
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    if (n.y < 0.0) {
+        n.xz = (1.0 - abs(n.zx)) * signNotZero(n.xz);
+    }
+    return normalize(n);
+}
+
+uvec2 packHalf4x16(vec4 v) {
+    return uvec2(packHalf2x16(v.xy), packHalf2x16(v.zw));
+}
+
+vec4 unpackHalf4x16(uvec2 v) {
+    return vec4(unpackHalf2x16(v.x), unpackHalf2x16(v.y));
+}
+
+uint packBladeUp(vec3 up) {
+    return packSnorm2x16(octEncode(up));
+}
+
+vec3 unpackBladeUp(uint up) {
+    return octDecode(unpackSnorm2x16(up));
+}
+
+uint packOrientation(float direction, vec3 up) {
+    uint turn = uint(round(fract(direction / BLADE_TWO_PI) * 65535.0));
+    return turn | (packSnorm4x8(vec4(octEncode(up), 0.0, 0.0)) << 16u);
+}
+
+float unpackDirection(uint orientation) {
+    return float(orientation & 0xffffu) * (BLADE_TWO_PI / 65535.0);
+}
+
+vec3 unpackOrientationUp(uint orientation) {
+    return octDecode(unpackSnorm4x8(orientation >> 16u).xy);
+}
@@ -0,0 +1,10 @@
+// Matches CameraBufferObject in Camera.h, bound at set 0 in every pipeline.
+// Everything past proj is derived on the CPU in Camera::UpdateBufferObject.
+layout(set = 0, binding = 0) uniform CameraBufferObject {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    mat4 invView;
+    vec4 eye;               // world-space camera position, w = 1
+    vec4 frustumPlanes[6];  // left, right, bottom, top, near, far; normalized, dot(plane, vec4(p, 1)) >= 0 inside
+} camera;
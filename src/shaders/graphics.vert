@@ -1,10 +1,8 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
 
-layout(set = 0, binding = 0) uniform CameraBufferObject {
-    mat4 view;
-	mat4 proj;
-} camera;
+#include "camera.glsl"
 
 layout(set = 1, binding = 0) uniform ModelBufferObject {
     mat4 model;
@@ -22,7 +20,7 @@ out gl_PerVertex {
 };
 
 void main() {
-    gl_Position = camera.proj * camera.view * model * vec4(inPosition, 1.0);
+    gl_Position = camera.viewProj * model * vec4(inPosition, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 }
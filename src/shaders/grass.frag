@@ -1,11 +1,8 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
 
-layout(set = 0, binding = 0) uniform CameraBufferObject 
-{
-    mat4 view;
-    mat4 proj;
-} camera;
+#include "camera.glsl"
 
 layout(location = 0) in vec3 fs_nor;
 layout(location = 0) out vec4 outColor;
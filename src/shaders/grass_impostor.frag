@@ -0,0 +1,46 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Number of blades cut out of each impostor card
+const uint CLUMP_BLADES = 5;
+
+layout(location = 0) in vec3 fs_nor;
+layout(location = 1) in vec2 fs_uv;
+layout(location = 2) flat in uint fs_seed;
+
+layout(location = 0) out vec4 outColor;
+
+vec3 lightDir = vec3(5, 2, 5);
+vec3 green = vec3(max(18, 100 * sin(fs_nor.x)), 250, max(18, 100 * cos(fs_nor.x))) / 255.0;
+
+uint hash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+void main() {
+    // Tapered blades of varying height and lean spread across the card
+    bool covered = false;
+    for (uint i = 0u; i < CLUMP_BLADES; i++) {
+        uint h = hash(fs_seed + i * 0x9e3779b9u);
+        float height = 0.6 + 0.4 * float(h & 0xffu) / 255.0;
+        float lean = (float((h >> 8) & 0xffu) / 255.0 - 0.5) * 0.3;
+
+        float center = (float(i) + 0.5) / float(CLUMP_BLADES) + lean * fs_uv.y;
+        float halfWidth = 0.5 / float(CLUMP_BLADES) * (1.0 - fs_uv.y / height);
+        covered = covered || (fs_uv.y < height && abs(fs_uv.x - center) < halfWidth);
+    }
+
+    if (!covered) {
+        discard;
+    }
+
+    float diffuseTerm = clamp(dot(normalize(fs_nor), normalize(lightDir)), 0.0, 1.0);
+    float ambientTerm = 0.25;
+    float lightIntensity = diffuseTerm + ambientTerm;
+    outColor = vec4(lightIntensity * green, 1.0);
+}
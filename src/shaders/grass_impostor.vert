@@ -0,0 +1,47 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+// Farthest LOD: one camera-facing card per blade, drawn as a 4 vertex strip.
+// The culling pass widens these to cover a clump, grass_impostor.frag cuts the blades out of it.
+#include "camera.glsl"
+#include "blade.glsl"
+
+layout(set = 1, binding = 0) uniform ModelBufferObject {
+    mat4 model;
+};
+
+// A CulledBlade, see blade.glsl
+layout(location = 0) in vec3 v0;
+layout(location = 1) in vec4 v1;
+layout(location = 2) in vec4 v2;
+layout(location = 3) in uint orientation;
+
+layout(location = 0) out vec3 fs_nor;
+layout(location = 1) out vec2 fs_uv;
+layout(location = 2) flat out uint fs_seed;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main() {
+    vec2 uv = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+
+    vec3 root = (model * vec4(v0, 1.0)).xyz;
+    vec3 tip = (model * vec4(v0 + v2.xyz, 1.0)).xyz;
+    vec3 upDir = normalize((model * vec4(unpackOrientationUp(orientation), 0.0)).xyz);
+
+    // Turn the card towards the camera around the blade's up axis
+    vec3 eye = camera.eye.xyz;
+    vec3 side = cross(upDir, eye - root);
+    side = dot(side, side) > 1e-8 ? normalize(side) : vec3(1.0, 0.0, 0.0);
+
+    vec3 p = mix(root, tip, uv.y) + side * v2.w * (2.0 * uv.x - 1.0);
+
+    fs_nor = normalize(cross(side, tip - root));
+    fs_uv = uv;
+    fs_seed = floatBitsToUint(v0.x) ^ (floatBitsToUint(v0.z) * 0x9e3779b9u);
+
+    gl_Position = camera.viewProj * vec4(p, 1.0);
+}
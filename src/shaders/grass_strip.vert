@@ -0,0 +1,55 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+// Low-poly blades without tessellation: each instance is one blade drawn as a fixed triangle strip,
+// shaped the same way grass.tese shapes the tessellated ones
+layout(constant_id = 0) const uint SEGMENTS = 2;
+
+#include "camera.glsl"
+#include "blade.glsl"
+
+layout(set = 1, binding = 0) uniform ModelBufferObject {
+    mat4 model;
+};
+
+// A CulledBlade, see blade.glsl
+layout(location = 0) in vec3 v0;
+layout(location = 1) in vec4 v1;
+layout(location = 2) in vec4 v2;
+layout(location = 3) in uint orientation;
+
+layout(location = 0) out vec3 fs_nor;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main() {
+    // Vertices alternate between the two edges of the blade, the last one is the tip
+    float u = float(gl_VertexIndex & 1);
+    float v = float(gl_VertexIndex >> 1) / float(SEGMENTS);
+
+    vec3 p0 = (model * vec4(v0, 1.0)).xyz;
+    vec3 p1 = (model * vec4(v0 + v1.xyz, 1.0)).xyz;
+    vec3 p2 = (model * vec4(v0 + v2.xyz, 1.0)).xyz;
+
+    // De Casteljau
+    vec3 a = p0 + v * (p1 - p0);
+    vec3 b = p1 + v * (p2 - p1);
+    vec3 c = a + v * (b - a);
+
+    float ori = unpackDirection(orientation);
+    float wid = v2.w;
+    vec3 t1 = vec3(cos(ori), 0.0, sin(ori));
+    vec3 c0 = c - wid * t1;
+    vec3 c1 = c + wid * t1;
+
+    vec3 t0 = normalize(b - a);
+    fs_nor = normalize(cross(t0, t1));
+
+    float t = u - u * v;
+    vec3 p = (1.0 - t) * c0 + t * c1;
+
+    gl_Position = camera.viewProj * vec4(p, 1.0);
+}
@@ -0,0 +1,58 @@
+// Hi-Z occlusion test shared by tiles.comp and compute.comp.
+// The pyramid holds the previous frame's depth, so bounds are reprojected with the view-projection it was rendered with.
+
+layout(set = 3, binding = 0) uniform OcclusionBufferObject {
+    mat4 viewProj;  // view-projection of the frame the pyramid was built from
+    vec2 size;      // size of pyramid level 0 in texels
+    uint mipLevels;
+    uint enabled;   // 0 until a pyramid has been built for the current frame resources
+} occlusion;
+
+layout(set = 3, binding = 1) uniform sampler2D hiZ;
+
+// True if the world-space box is entirely behind the previous frame's depth
+bool isOccluded(vec3 boundsMin, vec3 boundsMax) {
+    if (occlusion.enabled == 0) {
+        return false;
+    }
+
+    vec2 ndcMin = vec2(1.0);
+    vec2 ndcMax = vec2(-1.0);
+    float nearestDepth = 1.0;
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = vec3((i & 1) != 0 ? boundsMax.x : boundsMin.x,
+                           (i & 2) != 0 ? boundsMax.y : boundsMin.y,
+                           (i & 4) != 0 ? boundsMax.z : boundsMin.z);
+        vec4 clip = occlusion.viewProj * vec4(corner, 1.0);
+
+        // A box crossing the camera plane has no finite screen rect
+        if (clip.w <= 0.0) {
+            return false;
+        }
+
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc.xy);
+        ndcMax = max(ndcMax, ndc.xy);
+        nearestDepth = min(nearestDepth, ndc.z);
+    }
+
+    // Anything that was (partly) off screen last frame has no depth to be tested against
+    if (any(lessThan(ndcMin, vec2(-1.0))) || any(greaterThan(ndcMax, vec2(1.0)))) {
+        return false;
+    }
+
+    // Pick the level where the rect spans at most 2x2 texels and test its four corners
+    vec2 uvMin = ndcMin * 0.5 + 0.5;
+    vec2 uvMax = ndcMax * 0.5 + 0.5;
+    vec2 extent = (uvMax - uvMin) * occlusion.size;
+    int level = min(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), int(occlusion.mipLevels) - 1);
+
+    ivec2 levelSize = textureSize(hiZ, level);
+    ivec2 texelMin = clamp(ivec2(uvMin * vec2(levelSize)), ivec2(0), levelSize - 1);
+    ivec2 texelMax = clamp(ivec2(uvMax * vec2(levelSize)), ivec2(0), levelSize - 1);
+
+    float farthest = max(max(texelFetch(hiZ, texelMin, level).r, texelFetch(hiZ, ivec2(texelMax.x, texelMin.y), level).r),
+                         max(texelFetch(hiZ, ivec2(texelMin.x, texelMax.y), level).r, texelFetch(hiZ, texelMax, level).r));
+
+    return nearestDepth > farthest;
+}
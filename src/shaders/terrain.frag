@@ -0,0 +1,17 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 1, binding = 1) uniform sampler2D texSampler;
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+const vec3 LIGHT_DIR = normalize(vec3(0.4, 1.0, 0.3));
+
+void main() {
+    // Just enough shading for the hills to read under the grass
+    float lambert = max(dot(normalize(fragNormal), LIGHT_DIR), 0.0);
+    outColor = texture(texSampler, fragTexCoord) * vec4(vec3(0.6 + 0.4 * lambert), 1.0);
+}
@@ -0,0 +1,7 @@
+// Matches the constants in Terrain.h. The map holds the surface normal in xyz and the height in w.
+const float TERRAIN_MAP_SIZE = 120.0;
+
+vec4 sampleTerrain(sampler2D terrainMap, vec2 xz) {
+    vec4 texel = textureLod(terrainMap, xz / TERRAIN_MAP_SIZE, 0.0);
+    return vec4(normalize(texel.xyz), texel.w);
+}
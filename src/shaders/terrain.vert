@@ -0,0 +1,34 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "camera.glsl"
+#include "terrain.glsl"
+
+layout(set = 1, binding = 0) uniform ModelBufferObject {
+    mat4 model;
+};
+
+layout(set = 1, binding = 2) uniform sampler2D terrainMap;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragTexCoord;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main() {
+    // The grid is flat; lift it onto the surface at its world position
+    vec4 worldPosition = model * vec4(inPosition, 1.0);
+    vec4 surface = sampleTerrain(terrainMap, worldPosition.xz);
+    worldPosition.y += surface.w;
+
+    gl_Position = camera.viewProj * worldPosition;
+    fragNormal = surface.xyz;
+    fragTexCoord = inTexCoord;
+}